@@ -0,0 +1,17 @@
+#ifndef DB_POOL_H
+#define DB_POOL_H
+
+#include <glib.h>
+#include <sqlite3.h>
+
+typedef struct DbPool DbPool;
+
+DbPool* db_pool_new(const char *path, int size);
+sqlite3* db_pool_acquire(DbPool *pool);
+sqlite3* db_pool_acquire_timeout(DbPool *pool, gint64 timeout_us);
+void db_pool_release(DbPool *pool, sqlite3 *db);
+int db_pool_size(DbPool *pool);
+DbPool* db_pool_ref(DbPool *pool);
+void db_pool_unref(DbPool *pool);
+
+#endif
@@ -2,12 +2,18 @@
 #define GLOBALS_H
 
 #include <glib.h>
+#include "http_parser.h"
 
 typedef struct {
     char *cpf_path;
     char *cnpj_path;
     int port;
     char *interface;
+    int scan_threads;
+    int scan_threads_per_request;
+    int query_timeout_ms;
+    gboolean ktls;
+    HttpLimits http_limits;
 } ServerParams;
 
 extern GMutex server_mutex;
@@ -1,11 +1,12 @@
 #ifndef HANDLERS_H
 #define HANDLERS_H
 
-#include <openssl/ssl.h>
 #include <sqlite3.h>
+#include "db_pool.h"
+#include "response.h"
 
-void handle_get_person_by_cpf(SSL *ssl, sqlite3 *db, const char *cpf);
-void handle_get_person_by_name(SSL *ssl, sqlite3 *db, const char *name);
-void handle_get_person_by_exact_name(SSL *ssl, sqlite3 *db, const char *name);
+void handle_get_person_by_cpf(Response *res, sqlite3 *db, const char *cpf);
+void handle_get_person_by_name(Response *res, DbPool *pool, int parallelism, int timeout_ms, const char *name);
+void handle_get_person_by_exact_name(Response *res, sqlite3 *db, const char *name);
 
 #endif
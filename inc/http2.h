@@ -0,0 +1,20 @@
+#ifndef HTTP2_H
+#define HTTP2_H
+
+#include <openssl/ssl.h>
+#include "db_pool.h"
+#include "http_parser.h"
+
+#define H2_MAX_CONCURRENT_STREAMS 256
+#define H2_STREAM_WORKERS 16
+// Name scans run on their own workers so they cannot hold up CPF and exact-name lookups.
+#define H2_SCAN_WORKERS 4
+#define H2_MAX_PENDING_BYTES (256 * 1024)
+
+// Serves an ALPN-negotiated h2 connection until the peer goes away or the server stops. Streams run
+// concurrently on per-connection worker pools, one for name scans and one for everything else; chunks
+// a handler sends are framed as newline-delimited JSON in DATA frames, since HTTP/2 has no chunked
+// transfer coding. The caller keeps a reference to cpf_pool for the lifetime of the call.
+void http2_serve(SSL *ssl, int client_sock, const char *cpf_path, DbPool *cpf_pool, const HttpLimits *limits);
+
+#endif
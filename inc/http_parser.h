@@ -0,0 +1,74 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <glib.h>
+#include <stddef.h>
+
+#define HTTP_INLINE_BUFFER 4096
+#define HTTP_MAX_HEADERS 64
+#define HTTP_MAX_QUERY_PARAMS 32
+
+#define HTTP_DEFAULT_MAX_HEAD_BYTES 8192
+#define HTTP_DEFAULT_MAX_HEADERS 32
+#define HTTP_DEFAULT_MAX_BODY_BYTES (1024 * 1024)
+
+// Slices point into the request buffer and are NUL-terminated in place.
+typedef struct {
+    char *ptr;
+    size_t len;
+} HttpSlice;
+
+typedef struct {
+    HttpSlice name;
+    HttpSlice value;
+} HttpField;
+
+// Zero fields fall back to the HTTP_DEFAULT_* values.
+typedef struct {
+    size_t max_head_bytes;
+    size_t max_headers;
+    size_t max_body_bytes;
+} HttpLimits;
+
+typedef enum {
+    HTTP_PARSE_INCOMPLETE = 0,
+    HTTP_PARSE_DONE,
+    HTTP_PARSE_BAD_REQUEST,
+    HTTP_PARSE_HEAD_TOO_LARGE,
+    HTTP_PARSE_BODY_TOO_LARGE,
+    HTTP_PARSE_NOT_IMPLEMENTED
+} HttpParseStatus;
+
+typedef struct {
+    HttpLimits limits;
+    char *buf;
+    size_t len;
+    size_t cap;
+    size_t scan_pos;
+    size_t head_len;
+    size_t content_length;
+
+    HttpSlice method;
+    HttpSlice path;
+    HttpSlice version;
+    HttpSlice body;
+    HttpField headers[HTTP_MAX_HEADERS];
+    size_t header_count;
+    HttpField params[HTTP_MAX_QUERY_PARAMS];
+    size_t param_count;
+
+    char inline_buf[HTTP_INLINE_BUFFER];
+} HttpRequest;
+
+void http_limits_default(HttpLimits *limits);
+void http_request_init(HttpRequest *req, const HttpLimits *limits);
+void http_request_free(HttpRequest *req);
+char* http_request_reserve(HttpRequest *req, size_t *avail);
+HttpParseStatus http_request_commit(HttpRequest *req, size_t bytes);
+HttpParseStatus http_request_init_with(HttpRequest *req, const HttpLimits *limits, const char *data, size_t len);
+size_t http_request_consumed(const HttpRequest *req);
+const HttpSlice* http_request_header(const HttpRequest *req, const char *name);
+const HttpSlice* http_request_param(const HttpRequest *req, const char *name);
+gboolean http_percent_decode(char *s, size_t *len, gboolean plus_as_space);
+
+#endif
@@ -1,11 +1,34 @@
 #ifndef QUERIES_H
 #define QUERIES_H
 
+#include <glib.h>
 #include <sqlite3.h>
 #include <jansson.h>
+#include "db_pool.h"
+
+#define SCAN_MIN_RANGE_ROWS 50000
+#define SCAN_MAX_RANGE_ROWS 65536
+#define SCAN_RANGES_PER_WORKER 4
+#define SCAN_PROGRESS_OPS 10000
+#define SCAN_PROGRESS_INTERVAL_MS 250
+#define SCAN_ACQUIRE_POLL_MS 50
+
+typedef enum {
+    NAME_SCAN_COMPLETE,
+    NAME_SCAN_CANCELLED,
+    NAME_SCAN_TIMED_OUT,
+    // A statement failed; the rows delivered so far are not the full result.
+    NAME_SCAN_ERROR
+} NameScanStatus;
+
+// Called on the requesting thread with each non-empty rowid range in rowid order, or with rows == NULL
+// as a periodic progress report. Return FALSE to cancel the scan. On NAME_SCAN_TIMED_OUT every range
+// that finished before the deadline has been delivered, so only matches in ranges cut short are missing.
+typedef gboolean (*NameScanFunc)(json_t *rows, sqlite3_int64 rows_scanned, sqlite3_int64 rows_total, gpointer user_data);
 
 json_t* people_by_cpf(sqlite3 *db, const char *cpf);
-json_t* people_by_name(sqlite3 *db, const char *name);
+NameScanStatus people_by_name(DbPool *pool, const char *name, int parallelism, gint64 deadline,
+                              NameScanFunc on_rows, gpointer user_data);
 json_t* people_by_exact_name(sqlite3 *db, const char *name);
 
 #endif
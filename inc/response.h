@@ -0,0 +1,33 @@
+#ifndef RESPONSE_H
+#define RESPONSE_H
+
+#include <openssl/ssl.h>
+
+// Handlers write through a Response so the same code serves HTTP/1.1 chunked bodies and HTTP/2 streams.
+// Every call returns -1 once the client is gone.
+typedef struct Response Response;
+
+typedef struct {
+    int (*begin)(Response *res, int status);
+    int (*send_chunk)(Response *res, const char *data);
+    int (*end)(Response *res);
+    int (*empty)(Response *res, int status);
+} ResponseOps;
+
+struct Response {
+    const ResponseOps *ops;
+};
+
+typedef struct {
+    Response base;
+    SSL *ssl;
+} Http1Response;
+
+int response_begin(Response *res, int status);
+int response_send_chunk(Response *res, const char *data);
+int response_end(Response *res);
+int response_empty(Response *res, int status);
+const char* response_reason(int status);
+void http1_response_init(Http1Response *res, SSL *ssl);
+
+#endif
@@ -2,9 +2,20 @@
 #define SERVER_H
 
 #include <openssl/ssl.h>
+#include <sqlite3.h>
+#include "db_pool.h"
+#include "globals.h"
+#include "response.h"
 
-void send_chunk(SSL *ssl, const char *data);
-int start_server(int port, const char *cpf_path, const char *cnpj_path, const char *interface);
+#define SEND_CHUNK_COALESCE_BYTES 16384
+// How long a write may wait on a client that is not reading before the response is abandoned.
+#define SEND_TIMEOUT_MS 30000
+
+int send_chunk(SSL *ssl, const char *data);
+void route_request(Response *res, DbPool *cpf_pool, const char *method, const char *path, sqlite3 *cpf_db);
+// True for routes that run a name scan on cpf_pool and ignore cpf_db.
+gboolean route_is_scan(const char *path);
+int start_server(const ServerParams *params);
 int stop_server();
 
 #endif
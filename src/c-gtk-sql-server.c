@@ -7,7 +7,7 @@
 
 static gpointer server_thread_func(gpointer data) {
     ServerParams *params = (ServerParams *)data;
-    start_server(params->port, params->cpf_path, params->cnpj_path, params->interface);
+    start_server(params);
     g_free(params->cpf_path);
     g_free(params->cnpj_path);
     g_free(params);
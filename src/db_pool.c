@@ -0,0 +1,74 @@
+#include "db_pool.h"
+#include <glib.h>
+#include <stdio.h>
+#include <sqlite3.h>
+
+// Client threads outlive the accept loop, so each one holds a reference and the last
+// unref closes the connections.
+struct DbPool {
+    GAsyncQueue *idle;
+    sqlite3 **conns;
+    int size;
+    gint refcount;
+};
+
+static void db_pool_destroy(DbPool *pool) {
+    for (int i = 0; i < pool->size; i++) {
+        sqlite3_close(pool->conns[i]);
+    }
+    g_async_queue_unref(pool->idle);
+    g_free(pool->conns);
+    g_free(pool);
+}
+
+DbPool* db_pool_new(const char *path, int size) {
+    DbPool *pool = g_new0(DbPool, 1);
+    pool->idle = g_async_queue_new();
+    pool->conns = g_new0(sqlite3*, size);
+    pool->refcount = 1;
+
+    for (int i = 0; i < size; i++) {
+        sqlite3 *db;
+        if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+            fprintf(stderr, "[POOL] Database error: %s\n", sqlite3_errmsg(db));
+            sqlite3_close(db);
+            db_pool_destroy(pool);
+            return NULL;
+        }
+        pool->conns[pool->size++] = db;
+        g_async_queue_push(pool->idle, db);
+    }
+
+    printf("[POOL] Opened %d read-only connections to %s\n", pool->size, path);
+    return pool;
+}
+
+// Blocks until a connection is idle; the caller owns it until db_pool_release.
+sqlite3* db_pool_acquire(DbPool *pool) {
+    return g_async_queue_pop(pool->idle);
+}
+
+// Waits at most timeout_us for an idle connection; returns NULL if none became free in time.
+sqlite3* db_pool_acquire_timeout(DbPool *pool, gint64 timeout_us) {
+    return g_async_queue_timeout_pop(pool->idle, timeout_us > 0 ? (guint64)timeout_us : 0);
+}
+
+void db_pool_release(DbPool *pool, sqlite3 *db) {
+    g_async_queue_push(pool->idle, db);
+}
+
+int db_pool_size(DbPool *pool) {
+    return pool->size;
+}
+
+DbPool* db_pool_ref(DbPool *pool) {
+    g_atomic_int_inc(&pool->refcount);
+    return pool;
+}
+
+// Every holder releases its connections before dropping its reference.
+void db_pool_unref(DbPool *pool) {
+    if (g_atomic_int_dec_and_test(&pool->refcount)) {
+        db_pool_destroy(pool);
+    }
+}
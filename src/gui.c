@@ -8,6 +8,10 @@
 static GtkWidget *start_button;
 static GtkWidget *stop_button;
 static GtkWidget *port_entry;
+static GtkWidget *scan_threads_entry;
+static GtkWidget *scan_per_request_entry;
+static GtkWidget *timeout_entry;
+static GtkWidget *ktls_check;
 static GtkWidget *cpf_entry;
 static GtkWidget *cnpj_entry;
 static GtkWidget *interface_dropdown;
@@ -156,6 +160,9 @@ static void on_start_clicked(GtkButton *button, gpointer data) {
 
     const char *port_text = gtk_editable_get_text(GTK_EDITABLE(port_entry));
     int port = atoi(port_text);
+    int scan_threads = atoi(gtk_editable_get_text(GTK_EDITABLE(scan_threads_entry)));
+    int scan_per_request = atoi(gtk_editable_get_text(GTK_EDITABLE(scan_per_request_entry)));
+    int timeout_seconds = atoi(gtk_editable_get_text(GTK_EDITABLE(timeout_entry)));
     const char *cpf_path = gtk_editable_get_text(GTK_EDITABLE(cpf_entry));
     if (!cpf_path || !*cpf_path) {
         gtk_widget_add_css_class(cpf_entry, "error");
@@ -179,6 +186,12 @@ static void on_start_clicked(GtkButton *button, gpointer data) {
     params->cpf_path = g_strdup(cpf_path);
     params->cnpj_path = g_strdup(cnpj_path);
     params->interface = g_strdup(interface_ip);
+    params->scan_threads = scan_threads;
+    params->scan_threads_per_request = scan_per_request;
+    // Clamped so the conversion to milliseconds cannot overflow; 0 or less means no limit.
+    params->query_timeout_ms = CLAMP(timeout_seconds, 0, G_MAXINT / 1000) * 1000;
+    params->ktls = gtk_check_button_get_active(GTK_CHECK_BUTTON(ktls_check));
+    http_limits_default(&params->http_limits);
 
     start_server_thread(params);
 
@@ -245,18 +258,44 @@ void create_main_window(GtkApplication *app) {
     gtk_grid_attach(GTK_GRID(grid), port_label, 0, 3, 1, 1);
     gtk_grid_attach(GTK_GRID(grid), port_entry, 1, 3, 1, 1);
 
+    GtkWidget *scan_threads_label = gtk_label_new("Scan threads:");
+    scan_threads_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(scan_threads_entry), "Connections for name scans");
+    char *cpu_count = g_strdup_printf("%u", g_get_num_processors());
+    gtk_entry_buffer_set_text(gtk_entry_get_buffer(GTK_ENTRY(scan_threads_entry)), cpu_count, -1);
+    g_free(cpu_count);
+    gtk_grid_attach(GTK_GRID(grid), scan_threads_label, 0, 4, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), scan_threads_entry, 1, 4, 1, 1);
+
+    GtkWidget *scan_per_request_label = gtk_label_new("Scan threads per request:");
+    scan_per_request_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(scan_per_request_entry), "Cap for a single search");
+    gtk_entry_buffer_set_text(gtk_entry_get_buffer(GTK_ENTRY(scan_per_request_entry)), "4", -1);
+    gtk_grid_attach(GTK_GRID(grid), scan_per_request_label, 0, 5, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), scan_per_request_entry, 1, 5, 1, 1);
+
+    GtkWidget *timeout_label = gtk_label_new("Query timeout (s):");
+    timeout_entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(timeout_entry), "0 for no limit");
+    gtk_entry_buffer_set_text(gtk_entry_get_buffer(GTK_ENTRY(timeout_entry)), "30", -1);
+    gtk_grid_attach(GTK_GRID(grid), timeout_label, 0, 6, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), timeout_entry, 1, 6, 1, 1);
+
+    ktls_check = gtk_check_button_new_with_label("Kernel TLS offload");
+    gtk_grid_attach(GTK_GRID(grid), ktls_check, 0, 7, 2, 1);
+
     start_button = gtk_button_new_with_label("Start Server");
     g_signal_connect(start_button, "clicked", G_CALLBACK(on_start_clicked), NULL);
-    gtk_grid_attach(GTK_GRID(grid), start_button, 0, 4, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), start_button, 0, 8, 1, 1);
 
     stop_button = gtk_button_new_with_label("Stop Server");
     g_signal_connect(stop_button, "clicked", G_CALLBACK(on_stop_clicked), NULL);
-    gtk_grid_attach(GTK_GRID(grid), stop_button, 1, 4, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), stop_button, 1, 8, 1, 1);
     gtk_widget_set_sensitive(stop_button, FALSE);
 
     GtkWidget *close_button = gtk_button_new_with_label("Close");
     g_signal_connect(close_button, "clicked", G_CALLBACK(on_close_clicked), window);
-    gtk_grid_attach(GTK_GRID(grid), close_button, 0, 5, 2, 1);
+    gtk_grid_attach(GTK_GRID(grid), close_button, 0, 9, 2, 1);
 
     gtk_window_present(GTK_WINDOW(window));
 }
@@ -1,68 +1,109 @@
 #include "handlers.h"
 #include "queries.h"
-#include "server.h"
+#include "response.h"
+#include <glib.h>
 #include <jansson.h>
+#include <stdio.h>
+#include <string.h>
 
-void handle_get_person_by_cpf(SSL *ssl, sqlite3 *db, const char *cpf) {
-    const char *headers = "HTTP/1.1 200 OK\r\n"
-                          "Content-Type: application/json\r\n"
-                          "Transfer-Encoding: chunked\r\n"
-                          "Connection: close\r\n\r\n";
-    SSL_write(ssl, headers, strlen(headers));
+void handle_get_person_by_cpf(Response *res, sqlite3 *db, const char *cpf) {
+    response_begin(res, 200);
 
     json_t *result = people_by_cpf(db, cpf);
     char *results_json = json_dumps(result, JSON_COMPACT);
     char final_chunk[2048];
 
     snprintf(final_chunk, sizeof(final_chunk), "{\"results\":%s}", results_json);
-    send_chunk(ssl, final_chunk);
-    SSL_write(ssl, "0\r\n\r\n", 5);
+    response_send_chunk(res, final_chunk);
+    response_end(res);
 
     free(results_json);
     json_decref(result);
     printf("[CLIENT] CPF search completed for: %s\n", cpf);
 }
 
-void handle_get_person_by_name(SSL *ssl, sqlite3 *db, const char *name) {
-    const char *headers = "HTTP/1.1 200 OK\r\n"
-                          "Content-Type: application/json\r\n"
-                          "Transfer-Encoding: chunked\r\n"
-                          "Connection: close\r\n\r\n";
-    SSL_write(ssl, headers, strlen(headers));
+// Matches are streamed once, in the progress chunks; the final chunk only carries the status and
+// how many rows were sent.
+typedef struct {
+    Response *res;
+    size_t total;
+    int progress;
+} NameSearch;
 
-    send_chunk(ssl, "{\"status\":\"searching\",\"message\":\"Iniciando busca...\",\"progress\":0,\"isComplete\":false}");
-    send_chunk(ssl, "{\"status\":\"searching\",\"progress\":25,\"isComplete\":false}");
-    send_chunk(ssl, "{\"status\":\"processing\",\"progress\":75,\"isComplete\":false}");
+static gboolean stream_name_rows(json_t *rows, sqlite3_int64 rows_scanned, sqlite3_int64 rows_total, gpointer user_data) {
+    NameSearch *search = (NameSearch *)user_data;
+    // 100 is reserved for the final chunk.
+    search->progress = (int)MIN(rows_scanned * 100 / rows_total, 99);
 
-    json_t *result = people_by_name(db, name);
-    char *results_json = json_dumps(result, JSON_COMPACT);
-    char final_chunk[2048];
+    char *chunk;
+    if (rows) {
+        search->total += json_array_size(rows);
+        char *rows_json = json_dumps(rows, JSON_COMPACT);
+        chunk = g_strdup_printf(
+            "{\"status\":\"searching\",\"progress\":%d,\"isComplete\":false,\"results\":%s}",
+            search->progress, rows_json);
+        free(rows_json);
+    } else {
+        chunk = g_strdup_printf("{\"status\":\"searching\",\"progress\":%d,\"isComplete\":false}", search->progress);
+    }
 
-    snprintf(final_chunk, sizeof(final_chunk), 
-        "{\"status\":\"complete\",\"progress\":100,\"isComplete\":true,\"results\":%s}", 
-        results_json);
-    send_chunk(ssl, final_chunk);
-    SSL_write(ssl, "0\r\n\r\n", 5);
+    int sent = response_send_chunk(search->res, chunk);
+    g_free(chunk);
+    return sent == 0;
+}
 
-    free(results_json);
-    json_decref(result);
-    printf("[CLIENT] Name search completed for: %s\n", name);
+void handle_get_person_by_name(Response *res, DbPool *pool, int parallelism, int timeout_ms, const char *name) {
+    if (response_begin(res, 200) != 0 ||
+        response_send_chunk(res, "{\"status\":\"searching\",\"message\":\"Iniciando busca...\",\"progress\":0,\"isComplete\":false}") != 0) {
+        printf("[CLIENT] Client went away before name search for: %s\n", name);
+        return;
+    }
+
+    gint64 deadline = timeout_ms > 0 ? g_get_monotonic_time() + timeout_ms * G_TIME_SPAN_MILLISECOND : 0;
+    NameSearch search = { res, 0, 0 };
+    NameScanStatus status = people_by_name(pool, name, parallelism, deadline, stream_name_rows, &search);
+    if (status == NAME_SCAN_CANCELLED) {
+        printf("[CLIENT] Name search aborted, client went away: %s\n", name);
+        return;
+    }
+
+    static const char *outcomes[] = {
+        [NAME_SCAN_COMPLETE] = "completed",
+        [NAME_SCAN_TIMED_OUT] = "timed out",
+        [NAME_SCAN_ERROR] = "failed",
+    };
+    char *final_chunk;
+    if (status == NAME_SCAN_ERROR) {
+        // Headers are already out, so a failure can only be reported in the stream.
+        final_chunk = g_strdup_printf(
+            "{\"status\":\"error\",\"message\":\"Erro ao consultar o banco de dados\",\"progress\":%d,\"isComplete\":true,\"total\":%zu}",
+            search.progress, search.total);
+    } else if (status == NAME_SCAN_TIMED_OUT) {
+        final_chunk = g_strdup_printf(
+            "{\"status\":\"timeout\",\"message\":\"Tempo limite excedido\",\"progress\":%d,\"isComplete\":true,\"total\":%zu}",
+            search.progress, search.total);
+    } else {
+        final_chunk = g_strdup_printf(
+            "{\"status\":\"complete\",\"progress\":100,\"isComplete\":true,\"total\":%zu}",
+            search.total);
+    }
+    response_send_chunk(res, final_chunk);
+    response_end(res);
+
+    g_free(final_chunk);
+    printf("[CLIENT] Name search %s for: %s\n", outcomes[status], name);
 }
 
-void handle_get_person_by_exact_name(SSL *ssl, sqlite3 *db, const char *name) {
-    const char *headers = "HTTP/1.1 200 OK\r\n"
-                          "Content-Type: application/json\r\n"
-                          "Transfer-Encoding: chunked\r\n"
-                          "Connection: close\r\n\r\n";
-    SSL_write(ssl, headers, strlen(headers));
+void handle_get_person_by_exact_name(Response *res, sqlite3 *db, const char *name) {
+    response_begin(res, 200);
 
     json_t *result = people_by_exact_name(db, name);
     char *results_json = json_dumps(result, JSON_COMPACT);
     char final_chunk[2048];
 
     snprintf(final_chunk, sizeof(final_chunk), "{\"results\":%s}", results_json);
-    send_chunk(ssl, final_chunk);
-    SSL_write(ssl, "0\r\n\r\n", 5);
+    response_send_chunk(res, final_chunk);
+    response_end(res);
 
     free(results_json);
     json_decref(result);
@@ -0,0 +1,532 @@
+#include "http2.h"
+#include "globals.h"
+#include "response.h"
+#include "server.h"
+#include <glib.h>
+#include <nghttp2/nghttp2.h>
+#include <openssl/ssl.h>
+#include <sqlite3.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define H2_POLL_INTERVAL_MS 1000
+
+typedef struct H2Connection H2Connection;
+
+typedef struct {
+    Response base;
+    H2Connection *conn;
+    int32_t stream_id;
+    char *method;
+    char *path;
+    GByteArray *pending;
+    int status;
+    gboolean has_body;
+    gboolean eof;
+    gboolean busy;
+    gboolean closed;
+    gboolean dispatched;
+    gboolean submitted;
+    // The peer stopped opening its flow-control window for SEND_TIMEOUT_MS; the stream gets reset.
+    gboolean stalled;
+    // Session thread only: RST_STREAM has been submitted for a stalled stream.
+    gboolean reset;
+} H2Stream;
+
+// The session thread owns the nghttp2 session and the socket. Workers only touch stream state under
+// mutex and queue the stream id on ready, then poke wake_fds so the session thread submits or resumes it.
+struct H2Connection {
+    SSL *ssl;
+    int fd;
+    const char *cpf_path;
+    DbPool *cpf_pool;
+    size_t max_path_bytes;
+    nghttp2_session *session;
+    GThreadPool *workers;
+    GThreadPool *scan_workers;
+    GHashTable *streams;
+    GArray *ready;
+    GArray *ready_spare;
+    gboolean wake_pending;
+    gboolean dead;
+    gboolean want_write;
+    int wake_fds[2];
+    GMutex mutex;
+    GCond drained;
+};
+
+static void h2_stream_free(gpointer data) {
+    H2Stream *stream = (H2Stream *)data;
+    g_free(stream->method);
+    g_free(stream->path);
+    g_byte_array_free(stream->pending, TRUE);
+    g_free(stream);
+}
+
+// Caller holds conn->mutex.
+static void h2_notify(H2Stream *stream) {
+    H2Connection *conn = stream->conn;
+    g_array_append_val(conn->ready, stream->stream_id);
+    if (!conn->wake_pending) {
+        conn->wake_pending = TRUE;
+        if (write(conn->wake_fds[1], "x", 1) < 0) {
+            // The pipe is full, so the session thread is already due to wake up.
+        }
+    }
+}
+
+// Caller holds conn->mutex.
+static gboolean h2_stream_failed(H2Stream *stream) {
+    return stream->closed || stream->stalled || stream->conn->dead;
+}
+
+static int h2_begin(Response *res, int status) {
+    H2Stream *stream = (H2Stream *)res;
+    H2Connection *conn = stream->conn;
+    g_mutex_lock(&conn->mutex);
+    int rc = h2_stream_failed(stream) ? -1 : 0;
+    if (rc == 0) {
+        stream->status = status;
+        stream->has_body = TRUE;
+        h2_notify(stream);
+    }
+    g_mutex_unlock(&conn->mutex);
+    return rc;
+}
+
+static int h2_send_chunk(Response *res, const char *data) {
+    H2Stream *stream = (H2Stream *)res;
+    H2Connection *conn = stream->conn;
+    g_mutex_lock(&conn->mutex);
+    // Flow control: when the peer stops opening its window, hold the worker here instead of buffering,
+    // but give up after SEND_TIMEOUT_MS so a stalled peer cannot keep the worker and its scan forever.
+    gint64 give_up = g_get_monotonic_time() + SEND_TIMEOUT_MS * G_TIME_SPAN_MILLISECOND;
+    while (!h2_stream_failed(stream) && stream->pending->len > H2_MAX_PENDING_BYTES) {
+        if (!g_cond_wait_until(&conn->drained, &conn->mutex, give_up) && g_get_monotonic_time() >= give_up) {
+            printf("[H2] Stream %d stalled by flow control, resetting\n", stream->stream_id);
+            stream->stalled = TRUE;
+            h2_notify(stream);
+        }
+    }
+    int rc = h2_stream_failed(stream) ? -1 : 0;
+    if (rc == 0) {
+        g_byte_array_append(stream->pending, (const guint8 *)data, strlen(data));
+        g_byte_array_append(stream->pending, (const guint8 *)"\n", 1);
+        h2_notify(stream);
+    }
+    g_mutex_unlock(&conn->mutex);
+    return rc;
+}
+
+static int h2_end(Response *res) {
+    H2Stream *stream = (H2Stream *)res;
+    H2Connection *conn = stream->conn;
+    g_mutex_lock(&conn->mutex);
+    int rc = h2_stream_failed(stream) ? -1 : 0;
+    if (rc == 0) {
+        stream->eof = TRUE;
+        h2_notify(stream);
+    }
+    g_mutex_unlock(&conn->mutex);
+    return rc;
+}
+
+static int h2_empty(Response *res, int status) {
+    H2Stream *stream = (H2Stream *)res;
+    H2Connection *conn = stream->conn;
+    g_mutex_lock(&conn->mutex);
+    int rc = h2_stream_failed(stream) ? -1 : 0;
+    if (rc == 0) {
+        stream->status = status;
+        stream->has_body = FALSE;
+        stream->eof = TRUE;
+        h2_notify(stream);
+    }
+    g_mutex_unlock(&conn->mutex);
+    return rc;
+}
+
+static const ResponseOps h2_ops = {
+    h2_begin,
+    h2_send_chunk,
+    h2_end,
+    h2_empty
+};
+
+static ssize_t h2_read_body(nghttp2_session *session, int32_t stream_id, uint8_t *buf, size_t length,
+                            uint32_t *data_flags, nghttp2_data_source *source, void *user_data) {
+    (void)session;
+    (void)stream_id;
+    H2Stream *stream = (H2Stream *)source->ptr;
+    H2Connection *conn = (H2Connection *)user_data;
+
+    g_mutex_lock(&conn->mutex);
+    size_t n = MIN(length, stream->pending->len);
+    memcpy(buf, stream->pending->data, n);
+    g_byte_array_remove_range(stream->pending, 0, n);
+    gboolean eof = stream->eof && stream->pending->len == 0;
+    g_cond_broadcast(&conn->drained);
+    g_mutex_unlock(&conn->mutex);
+
+    if (eof) {
+        *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+    } else if (n == 0) {
+        // Resumed from h2_process_ready once the worker queues more output.
+        return NGHTTP2_ERR_DEFERRED;
+    }
+    return n;
+}
+
+static void h2_submit(H2Connection *conn, H2Stream *stream, int status, gboolean has_body) {
+    char status_str[8];
+    snprintf(status_str, sizeof(status_str), "%d", status);
+    nghttp2_nv headers[] = {
+        { (uint8_t *)":status", (uint8_t *)status_str, 7, strlen(status_str), NGHTTP2_NV_FLAG_NONE },
+        { (uint8_t *)"content-type", (uint8_t *)"application/json", 12, 16, NGHTTP2_NV_FLAG_NONE }
+    };
+    nghttp2_data_provider body;
+    body.source.ptr = stream;
+    body.read_callback = h2_read_body;
+
+    stream->submitted = TRUE;
+    nghttp2_submit_response(conn->session, stream->stream_id, headers, has_body ? 2 : 1, has_body ? &body : NULL);
+}
+
+// Lookup connection owned by a worker thread. Worker threads outlive connections, so the database
+// stays open across streams and connections and is closed when the thread exits.
+typedef struct {
+    char *path;
+    sqlite3 *db;
+} H2ThreadDb;
+
+static void h2_thread_db_free(gpointer data) {
+    H2ThreadDb *thread_db = (H2ThreadDb *)data;
+    sqlite3_close(thread_db->db);
+    g_free(thread_db->path);
+    g_free(thread_db);
+}
+
+static GPrivate h2_thread_db_key = G_PRIVATE_INIT(h2_thread_db_free);
+
+static sqlite3 *h2_thread_db(const char *path) {
+    H2ThreadDb *thread_db = g_private_get(&h2_thread_db_key);
+    if (thread_db && strcmp(thread_db->path, path) == 0) {
+        return thread_db->db;
+    }
+
+    sqlite3 *db;
+    if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+        fprintf(stderr, "[H2] Database error: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return NULL;
+    }
+    thread_db = g_new(H2ThreadDb, 1);
+    thread_db->path = g_strdup(path);
+    thread_db->db = db;
+    g_private_replace(&h2_thread_db_key, thread_db);
+    return db;
+}
+
+static void h2_stream_worker(gpointer data, gpointer user_data) {
+    H2Stream *stream = (H2Stream *)data;
+    H2Connection *conn = (H2Connection *)user_data;
+
+    printf("[H2] Stream %d on fd=%d: %s %s\n", stream->stream_id, conn->fd, stream->method, stream->path);
+    // Scans take their connections from cpf_pool; lookups use this thread's own connection.
+    gboolean scan = route_is_scan(stream->path);
+    sqlite3 *cpf_db = scan ? NULL : h2_thread_db(conn->cpf_path);
+    if (scan || cpf_db) {
+        route_request(&stream->base, conn->cpf_pool, stream->method, stream->path, cpf_db);
+    } else {
+        response_empty(&stream->base, 500);
+    }
+
+    g_mutex_lock(&conn->mutex);
+    stream->busy = FALSE;
+    if (stream->closed) {
+        g_hash_table_remove(conn->streams, GINT_TO_POINTER(stream->stream_id));
+    }
+    g_mutex_unlock(&conn->mutex);
+}
+
+static void h2_dispatch(H2Connection *conn, H2Stream *stream) {
+    stream->dispatched = TRUE;
+    if (!stream->method || !stream->path) {
+        nghttp2_submit_rst_stream(conn->session, NGHTTP2_FLAG_NONE, stream->stream_id, NGHTTP2_PROTOCOL_ERROR);
+        return;
+    }
+
+    // Same treatment as the HTTP/1.1 parser: drop the query string and percent-decode the path in place.
+    char *query = strchr(stream->path, '?');
+    if (query) {
+        *query = '\0';
+    }
+    size_t path_len = strlen(stream->path);
+    if (stream->path[0] != '/' || !http_percent_decode(stream->path, &path_len, FALSE)) {
+        h2_submit(conn, stream, 400, FALSE);
+        return;
+    }
+
+    g_mutex_lock(&conn->mutex);
+    stream->busy = TRUE;
+    g_mutex_unlock(&conn->mutex);
+    g_thread_pool_push(route_is_scan(stream->path) ? conn->scan_workers : conn->workers, stream, NULL);
+}
+
+static ssize_t h2_send(nghttp2_session *session, const uint8_t *data, size_t length, int flags, void *user_data) {
+    (void)session;
+    (void)flags;
+    H2Connection *conn = (H2Connection *)user_data;
+    int n = SSL_write(conn->ssl, data, (int)MIN(length, INT_MAX));
+    if (n > 0) {
+        return n;
+    }
+    int err = SSL_get_error(conn->ssl, n);
+    if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ) {
+        conn->want_write = TRUE;
+        return NGHTTP2_ERR_WOULDBLOCK;
+    }
+    return NGHTTP2_ERR_CALLBACK_FAILURE;
+}
+
+static int h2_on_begin_headers(nghttp2_session *session, const nghttp2_frame *frame, void *user_data) {
+    H2Connection *conn = (H2Connection *)user_data;
+    if (frame->hd.type != NGHTTP2_HEADERS || frame->headers.cat != NGHTTP2_HCAT_REQUEST) {
+        return 0;
+    }
+
+    H2Stream *stream = g_new0(H2Stream, 1);
+    stream->base.ops = &h2_ops;
+    stream->conn = conn;
+    stream->stream_id = frame->hd.stream_id;
+    stream->pending = g_byte_array_new();
+
+    g_mutex_lock(&conn->mutex);
+    g_hash_table_insert(conn->streams, GINT_TO_POINTER(stream->stream_id), stream);
+    g_mutex_unlock(&conn->mutex);
+    nghttp2_session_set_stream_user_data(session, stream->stream_id, stream);
+    return 0;
+}
+
+static int h2_on_header(nghttp2_session *session, const nghttp2_frame *frame, const uint8_t *name, size_t namelen,
+                        const uint8_t *value, size_t valuelen, uint8_t flags, void *user_data) {
+    (void)flags;
+    H2Connection *conn = (H2Connection *)user_data;
+    if (frame->hd.type != NGHTTP2_HEADERS || frame->headers.cat != NGHTTP2_HCAT_REQUEST) {
+        return 0;
+    }
+    H2Stream *stream = nghttp2_session_get_stream_user_data(session, frame->hd.stream_id);
+    if (!stream) {
+        return 0;
+    }
+
+    if (namelen == 5 && memcmp(name, ":path", 5) == 0) {
+        if (valuelen > conn->max_path_bytes) {
+            return NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE;
+        }
+        g_free(stream->path);
+        stream->path = g_strndup((const char *)value, valuelen);
+    } else if (namelen == 7 && memcmp(name, ":method", 7) == 0) {
+        g_free(stream->method);
+        stream->method = g_strndup((const char *)value, valuelen);
+    }
+    return 0;
+}
+
+static int h2_on_frame_recv(nghttp2_session *session, const nghttp2_frame *frame, void *user_data) {
+    H2Connection *conn = (H2Connection *)user_data;
+    if ((frame->hd.type != NGHTTP2_HEADERS && frame->hd.type != NGHTTP2_DATA) ||
+        !(frame->hd.flags & NGHTTP2_FLAG_END_STREAM)) {
+        return 0;
+    }
+    // Request bodies are ignored, as for HTTP/1.1; the request is dispatched once the client half-closes.
+    H2Stream *stream = nghttp2_session_get_stream_user_data(session, frame->hd.stream_id);
+    if (stream && !stream->dispatched) {
+        h2_dispatch(conn, stream);
+    }
+    return 0;
+}
+
+static int h2_on_stream_close(nghttp2_session *session, int32_t stream_id, uint32_t error_code, void *user_data) {
+    (void)error_code;
+    H2Connection *conn = (H2Connection *)user_data;
+    H2Stream *stream = nghttp2_session_get_stream_user_data(session, stream_id);
+    if (!stream) {
+        return 0;
+    }
+
+    // A busy stream is freed by its worker once the handler notices the failed writes and returns.
+    g_mutex_lock(&conn->mutex);
+    stream->closed = TRUE;
+    g_cond_broadcast(&conn->drained);
+    if (!stream->busy) {
+        g_hash_table_remove(conn->streams, GINT_TO_POINTER(stream_id));
+    }
+    g_mutex_unlock(&conn->mutex);
+    return 0;
+}
+
+static void h2_process_ready(H2Connection *conn) {
+    char drain[64];
+    while (read(conn->wake_fds[0], drain, sizeof(drain)) > 0) {
+    }
+
+    g_mutex_lock(&conn->mutex);
+    GArray *ready = conn->ready;
+    conn->ready = conn->ready_spare;
+    conn->ready_spare = ready;
+    conn->wake_pending = FALSE;
+    g_mutex_unlock(&conn->mutex);
+
+    for (guint i = 0; i < ready->len; i++) {
+        int32_t stream_id = g_array_index(ready, int32_t, i);
+        H2Stream *stream = nghttp2_session_get_stream_user_data(conn->session, stream_id);
+        if (!stream) {
+            continue;
+        }
+
+        g_mutex_lock(&conn->mutex);
+        int status = stream->status;
+        gboolean has_body = stream->has_body;
+        gboolean stalled = stream->stalled;
+        g_mutex_unlock(&conn->mutex);
+        if (stalled) {
+            if (!stream->reset) {
+                stream->reset = TRUE;
+                nghttp2_submit_rst_stream(conn->session, NGHTTP2_FLAG_NONE, stream_id, NGHTTP2_CANCEL);
+            }
+        } else if (stream->submitted) {
+            nghttp2_session_resume_data(conn->session, stream_id);
+        } else if (status) {
+            h2_submit(conn, stream, status, has_body);
+        }
+    }
+    g_array_set_size(ready, 0);
+}
+
+static int h2_recv(H2Connection *conn) {
+    uint8_t buf[16384];
+    while (TRUE) {
+        int n = SSL_read(conn->ssl, buf, sizeof(buf));
+        if (n <= 0) {
+            int err = SSL_get_error(conn->ssl, n);
+            return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ? 0 : -1;
+        }
+        if (nghttp2_session_mem_recv(conn->session, buf, n) < 0) {
+            return -1;
+        }
+    }
+}
+
+static gboolean server_is_running(void) {
+    g_mutex_lock(&server_mutex);
+    gboolean running = server_running;
+    g_mutex_unlock(&server_mutex);
+    return running;
+}
+
+static void h2_run(H2Connection *conn) {
+    gboolean stopping = FALSE;
+    while (TRUE) {
+        conn->want_write = FALSE;
+        if (nghttp2_session_send(conn->session) != 0) {
+            break;
+        }
+        if (!nghttp2_session_want_read(conn->session) && !nghttp2_session_want_write(conn->session)) {
+            break;
+        }
+        if (!stopping && !server_is_running()) {
+            nghttp2_session_terminate_session(conn->session, NGHTTP2_NO_ERROR);
+            stopping = TRUE;
+            continue;
+        }
+
+        struct pollfd fds[2] = {
+            { conn->fd, POLLIN | (conn->want_write ? POLLOUT : 0), 0 },
+            { conn->wake_fds[0], POLLIN, 0 }
+        };
+        // Records OpenSSL has already decrypted will not show up as socket readiness.
+        if (SSL_pending(conn->ssl) == 0 && poll(fds, 2, H2_POLL_INTERVAL_MS) < 0 && errno != EINTR) {
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            h2_process_ready(conn);
+        }
+        if (SSL_pending(conn->ssl) > 0 || (fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+            if (h2_recv(conn) != 0) {
+                break;
+            }
+        }
+    }
+}
+
+void http2_serve(SSL *ssl, int client_sock, const char *cpf_path, DbPool *cpf_pool, const HttpLimits *limits) {
+    H2Connection conn = {0};
+    conn.ssl = ssl;
+    conn.fd = client_sock;
+    conn.cpf_path = cpf_path;
+    conn.cpf_pool = cpf_pool;
+    conn.max_path_bytes = limits->max_head_bytes;
+
+    if (pipe(conn.wake_fds) != 0) {
+        perror("[H2] pipe");
+        return;
+    }
+    fcntl(conn.wake_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(conn.wake_fds[1], F_SETFL, O_NONBLOCK);
+    int sock_flags = fcntl(client_sock, F_GETFL);
+    fcntl(client_sock, F_SETFL, sock_flags | O_NONBLOCK);
+    SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    g_mutex_init(&conn.mutex);
+    g_cond_init(&conn.drained);
+    conn.streams = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, h2_stream_free);
+    conn.ready = g_array_new(FALSE, FALSE, sizeof(int32_t));
+    conn.ready_spare = g_array_new(FALSE, FALSE, sizeof(int32_t));
+    conn.workers = g_thread_pool_new(h2_stream_worker, &conn, H2_STREAM_WORKERS, FALSE, NULL);
+    conn.scan_workers = g_thread_pool_new(h2_stream_worker, &conn, H2_SCAN_WORKERS, FALSE, NULL);
+
+    nghttp2_session_callbacks *callbacks;
+    nghttp2_session_callbacks_new(&callbacks);
+    nghttp2_session_callbacks_set_send_callback(callbacks, h2_send);
+    nghttp2_session_callbacks_set_on_begin_headers_callback(callbacks, h2_on_begin_headers);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks, h2_on_header);
+    nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks, h2_on_frame_recv);
+    nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, h2_on_stream_close);
+    nghttp2_session_server_new(&conn.session, callbacks, &conn);
+    nghttp2_session_callbacks_del(callbacks);
+
+    nghttp2_settings_entry settings[] = {
+        { NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, H2_MAX_CONCURRENT_STREAMS },
+        { NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE, (uint32_t)limits->max_head_bytes }
+    };
+    nghttp2_submit_settings(conn.session, NGHTTP2_FLAG_NONE, settings, G_N_ELEMENTS(settings));
+
+    printf("[H2] Serving HTTP/2 on client fd=%d\n", client_sock);
+    h2_run(&conn);
+
+    // Fail any writes still in flight, drop queued streams and wait for running handlers to return.
+    g_mutex_lock(&conn.mutex);
+    conn.dead = TRUE;
+    g_cond_broadcast(&conn.drained);
+    g_mutex_unlock(&conn.mutex);
+    g_thread_pool_free(conn.workers, TRUE, TRUE);
+    g_thread_pool_free(conn.scan_workers, TRUE, TRUE);
+
+    nghttp2_session_del(conn.session);
+    g_hash_table_destroy(conn.streams);
+    g_array_free(conn.ready, TRUE);
+    g_array_free(conn.ready_spare, TRUE);
+    g_cond_clear(&conn.drained);
+    g_mutex_clear(&conn.mutex);
+    close(conn.wake_fds[0]);
+    close(conn.wake_fds[1]);
+    fcntl(client_sock, F_SETFL, sock_flags);
+    printf("[H2] Connection closed on client fd=%d\n", client_sock);
+}
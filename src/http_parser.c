@@ -0,0 +1,357 @@
+#include "http_parser.h"
+#include <glib.h>
+#include <stddef.h>
+#include <string.h>
+
+void http_limits_default(HttpLimits *limits) {
+    limits->max_head_bytes = HTTP_DEFAULT_MAX_HEAD_BYTES;
+    limits->max_headers = HTTP_DEFAULT_MAX_HEADERS;
+    limits->max_body_bytes = HTTP_DEFAULT_MAX_BODY_BYTES;
+}
+
+void http_request_init(HttpRequest *req, const HttpLimits *limits) {
+    memset(req, 0, offsetof(HttpRequest, inline_buf));
+    http_limits_default(&req->limits);
+    if (limits && limits->max_head_bytes) {
+        req->limits.max_head_bytes = limits->max_head_bytes;
+    }
+    if (limits && limits->max_headers) {
+        req->limits.max_headers = limits->max_headers;
+    }
+    if (limits && limits->max_body_bytes) {
+        req->limits.max_body_bytes = limits->max_body_bytes;
+    }
+    if (req->limits.max_headers > HTTP_MAX_HEADERS) {
+        req->limits.max_headers = HTTP_MAX_HEADERS;
+    }
+    req->buf = req->inline_buf;
+    req->cap = sizeof(req->inline_buf);
+}
+
+void http_request_free(HttpRequest *req) {
+    if (req->buf != req->inline_buf) {
+        g_free(req->buf);
+    }
+    req->buf = NULL;
+}
+
+static void rebase_slice(HttpSlice *slice, const char *old_buf, char *new_buf) {
+    if (slice->ptr) {
+        slice->ptr = new_buf + (slice->ptr - old_buf);
+    }
+}
+
+static void grow_buffer(HttpRequest *req, size_t new_cap) {
+    char *old_buf = req->buf;
+    char *new_buf = g_malloc(new_cap);
+    memcpy(new_buf, old_buf, req->len);
+
+    rebase_slice(&req->method, old_buf, new_buf);
+    rebase_slice(&req->path, old_buf, new_buf);
+    rebase_slice(&req->version, old_buf, new_buf);
+    for (size_t i = 0; i < req->header_count; i++) {
+        rebase_slice(&req->headers[i].name, old_buf, new_buf);
+        rebase_slice(&req->headers[i].value, old_buf, new_buf);
+    }
+    for (size_t i = 0; i < req->param_count; i++) {
+        rebase_slice(&req->params[i].name, old_buf, new_buf);
+        rebase_slice(&req->params[i].value, old_buf, new_buf);
+    }
+
+    if (old_buf != req->inline_buf) {
+        g_free(old_buf);
+    }
+    req->buf = new_buf;
+    req->cap = new_cap;
+}
+
+// Returns where the next read should land. Reads are capped at the end of the current request once
+// the head has been parsed; bytes of a following request that arrived with the head stay in the buffer
+// past http_request_consumed().
+char* http_request_reserve(HttpRequest *req, size_t *avail) {
+    size_t limit = req->head_len ? req->head_len + req->content_length : req->limits.max_head_bytes;
+    if (req->len >= limit) {
+        *avail = 0;
+        return NULL;
+    }
+    if (req->len == req->cap) {
+        // Once Content-Length is known (and within limits) grow straight to the final size.
+        grow_buffer(req, req->head_len ? limit : MIN(req->cap * 2, limit));
+    }
+    *avail = MIN(req->cap, limit) - req->len;
+    return req->buf + req->len;
+}
+
+// Seeds a fresh request with bytes carried over from a previous one, which may already hold a
+// complete request. data must not point into req's own buffer.
+HttpParseStatus http_request_init_with(HttpRequest *req, const HttpLimits *limits, const char *data, size_t len) {
+    http_request_init(req, limits);
+    if (len == 0) {
+        return HTTP_PARSE_INCOMPLETE;
+    }
+    if (len > req->cap) {
+        grow_buffer(req, len);
+    }
+    memcpy(req->buf, data, len);
+    return http_request_commit(req, len);
+}
+
+// Bytes of the buffer that belong to a completed request; anything after them was read ahead.
+size_t http_request_consumed(const HttpRequest *req) {
+    return req->head_len + req->content_length;
+}
+
+// Decodes in place and NUL-terminates. Rejects malformed escapes and encoded NUL bytes.
+gboolean http_percent_decode(char *s, size_t *len, gboolean plus_as_space) {
+    char *src = memchr(s, '%', *len);
+    char *end = s + *len;
+    char *dst;
+
+    if (!plus_as_space && !src) {
+        s[*len] = '\0';
+        return TRUE;
+    }
+    if (!src || plus_as_space) {
+        src = s;
+    }
+
+    for (dst = src; src < end; src++, dst++) {
+        if (*src == '%') {
+            if (end - src < 3) return FALSE;
+            int hi = g_ascii_xdigit_value(src[1]);
+            int lo = g_ascii_xdigit_value(src[2]);
+            if (hi < 0 || lo < 0 || (hi == 0 && lo == 0)) return FALSE;
+            *dst = (char)(hi << 4 | lo);
+            src += 2;
+        } else if (*src == '+' && plus_as_space) {
+            *dst = ' ';
+        } else {
+            *dst = *src;
+        }
+    }
+    *dst = '\0';
+    *len = dst - s;
+    return TRUE;
+}
+
+static gboolean find_head_end(HttpRequest *req) {
+    char *end = req->buf + req->len;
+    char *p = req->buf + req->scan_pos;
+
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        size_t left = end - p - 1;
+        if (left >= 1 && p[1] == '\n') {
+            req->head_len = p + 2 - req->buf;
+            return TRUE;
+        }
+        if (left >= 2 && p[1] == '\r' && p[2] == '\n') {
+            req->head_len = p + 3 - req->buf;
+            return TRUE;
+        }
+        if (left == 0 || (left == 1 && p[1] == '\r')) {
+            // Resume from this newline once more bytes arrive.
+            req->scan_pos = p - req->buf;
+            return FALSE;
+        }
+        p++;
+    }
+    req->scan_pos = req->len;
+    return FALSE;
+}
+
+static HttpParseStatus parse_target(HttpRequest *req, char *target, char *target_end) {
+    if (target == target_end || *target != '/') {
+        return HTTP_PARSE_BAD_REQUEST;
+    }
+
+    char *query = memchr(target, '?', target_end - target);
+    char *path_end = query ? query : target_end;
+    req->path.ptr = target;
+    req->path.len = path_end - target;
+    if (!http_percent_decode(req->path.ptr, &req->path.len, FALSE)) {
+        return HTTP_PARSE_BAD_REQUEST;
+    }
+    if (!query) {
+        return HTTP_PARSE_DONE;
+    }
+
+    for (char *p = query + 1; p < target_end;) {
+        char *amp = memchr(p, '&', target_end - p);
+        char *pair_end = amp ? amp : target_end;
+        if (pair_end > p) {
+            if (req->param_count >= HTTP_MAX_QUERY_PARAMS) {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+            HttpField *param = &req->params[req->param_count++];
+            char *eq = memchr(p, '=', pair_end - p);
+            char *name_end = eq ? eq : pair_end;
+            param->name.ptr = p;
+            param->name.len = name_end - p;
+            param->value.ptr = eq ? eq + 1 : pair_end;
+            param->value.len = eq ? (size_t)(pair_end - eq - 1) : 0;
+            if (!http_percent_decode(param->name.ptr, &param->name.len, TRUE) ||
+                !http_percent_decode(param->value.ptr, &param->value.len, TRUE)) {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+        }
+        p = pair_end + 1;
+    }
+    return HTTP_PARSE_DONE;
+}
+
+// CTL bytes (including a raw NUL or a bare CR) would let a slice's length disagree with its C string.
+static gboolean has_ctl(const char *p, const char *end, gboolean allow_tab) {
+    for (; p < end; p++) {
+        unsigned char c = (unsigned char)*p;
+        if ((c < 0x20 && !(allow_tab && c == '\t')) || c == 0x7F) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static char* line_stop(char *line, char *eol) {
+    return (eol > line && eol[-1] == '\r') ? eol - 1 : eol;
+}
+
+static HttpParseStatus parse_content_length(HttpRequest *req) {
+    if (http_request_header(req, "Transfer-Encoding")) {
+        return HTTP_PARSE_NOT_IMPLEMENTED;
+    }
+
+    gboolean seen = FALSE;
+    for (size_t i = 0; i < req->header_count; i++) {
+        if (g_ascii_strcasecmp(req->headers[i].name.ptr, "Content-Length") != 0) continue;
+
+        const HttpSlice *value = &req->headers[i].value;
+        size_t length = 0;
+        if (value->len == 0 || value->len > 18) {
+            return HTTP_PARSE_BAD_REQUEST;
+        }
+        for (size_t j = 0; j < value->len; j++) {
+            if (value->ptr[j] < '0' || value->ptr[j] > '9') {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+            length = length * 10 + (value->ptr[j] - '0');
+        }
+        if (seen && length != req->content_length) {
+            return HTTP_PARSE_BAD_REQUEST;
+        }
+        seen = TRUE;
+        req->content_length = length;
+    }
+
+    if (req->content_length > req->limits.max_body_bytes) {
+        return HTTP_PARSE_BODY_TOO_LARGE;
+    }
+    return HTTP_PARSE_DONE;
+}
+
+static HttpParseStatus parse_head(HttpRequest *req) {
+    char *end = req->buf + req->head_len;
+    char *eol = memchr(req->buf, '\n', end - req->buf);
+    char *stop = line_stop(req->buf, eol);
+    if (has_ctl(req->buf, stop, FALSE)) {
+        return HTTP_PARSE_BAD_REQUEST;
+    }
+
+    char *sp1 = memchr(req->buf, ' ', stop - req->buf);
+    if (!sp1 || sp1 == req->buf) {
+        return HTTP_PARSE_BAD_REQUEST;
+    }
+    char *target = sp1 + 1;
+    char *sp2 = memchr(target, ' ', stop - target);
+    if (!sp2) {
+        return HTTP_PARSE_BAD_REQUEST;
+    }
+    char *version = sp2 + 1;
+    if (stop - version != 8 ||
+        (strncmp(version, "HTTP/1.1", 8) != 0 && strncmp(version, "HTTP/1.0", 8) != 0)) {
+        return HTTP_PARSE_BAD_REQUEST;
+    }
+
+    *sp1 = '\0';
+    *sp2 = '\0';
+    *stop = '\0';
+    req->method.ptr = req->buf;
+    req->method.len = sp1 - req->buf;
+    req->version.ptr = version;
+    req->version.len = stop - version;
+
+    HttpParseStatus status = parse_target(req, target, sp2);
+    if (status != HTTP_PARSE_DONE) {
+        return status;
+    }
+
+    for (char *line = eol + 1; line < end; line = eol + 1) {
+        eol = memchr(line, '\n', end - line);
+        stop = line_stop(line, eol);
+        if (stop == line) {
+            break;
+        }
+        // Obsolete line folding is rejected, as is whitespace between the name and the colon.
+        char *colon = memchr(line, ':', stop - line);
+        if (*line == ' ' || *line == '\t' || !colon || colon == line ||
+            colon[-1] == ' ' || colon[-1] == '\t' ||
+            has_ctl(line, colon, FALSE) || has_ctl(colon + 1, stop, TRUE)) {
+            return HTTP_PARSE_BAD_REQUEST;
+        }
+        if (req->header_count >= req->limits.max_headers) {
+            return HTTP_PARSE_HEAD_TOO_LARGE;
+        }
+
+        char *value = colon + 1;
+        char *value_end = stop;
+        while (value < value_end && (*value == ' ' || *value == '\t')) value++;
+        while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+        *colon = '\0';
+        *value_end = '\0';
+
+        HttpField *header = &req->headers[req->header_count++];
+        header->name.ptr = line;
+        header->name.len = colon - line;
+        header->value.ptr = value;
+        header->value.len = value_end - value;
+    }
+
+    return parse_content_length(req);
+}
+
+HttpParseStatus http_request_commit(HttpRequest *req, size_t bytes) {
+    req->len += bytes;
+
+    if (!req->head_len) {
+        if (!find_head_end(req)) {
+            return req->len >= req->limits.max_head_bytes ? HTTP_PARSE_HEAD_TOO_LARGE : HTTP_PARSE_INCOMPLETE;
+        }
+        HttpParseStatus status = parse_head(req);
+        if (status != HTTP_PARSE_DONE) {
+            return status;
+        }
+    }
+
+    if (req->len - req->head_len < req->content_length) {
+        return HTTP_PARSE_INCOMPLETE;
+    }
+    req->body.ptr = req->buf + req->head_len;
+    req->body.len = req->content_length;
+    return HTTP_PARSE_DONE;
+}
+
+const HttpSlice* http_request_header(const HttpRequest *req, const char *name) {
+    for (size_t i = 0; i < req->header_count; i++) {
+        if (g_ascii_strcasecmp(req->headers[i].name.ptr, name) == 0) {
+            return &req->headers[i].value;
+        }
+    }
+    return NULL;
+}
+
+const HttpSlice* http_request_param(const HttpRequest *req, const char *name) {
+    for (size_t i = 0; i < req->param_count; i++) {
+        if (strcmp(req->params[i].name.ptr, name) == 0) {
+            return &req->params[i].value;
+        }
+    }
+    return NULL;
+}
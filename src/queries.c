@@ -1,4 +1,7 @@
 #include "queries.h"
+#include "db_pool.h"
+#include <glib.h>
+#include <stdio.h>
 #include <string.h>
 #include <jansson.h>
 #include <sqlite3.h>
@@ -24,27 +27,279 @@ json_t* people_by_cpf(sqlite3 *db, const char *cpf) {
     return result;
 }
 
-json_t* people_by_name(sqlite3 *db, const char *name) {
-    printf("[DEBUG] handle_get_person_by_name received name: '%s'\n", name);
-    const char *sql = "SELECT cpf, nome, sexo, nasc FROM cpf WHERE nome LIKE ?";
+typedef struct {
+    sqlite3_int64 first;
+    sqlite3_int64 last;
+    json_t *rows;
+    gboolean done;
+    // FALSE when the scan stopped before the range was fully read.
+    gboolean complete;
+    // Set when SQLite failed rather than being interrupted by the deadline or cancellation.
+    gboolean failed;
+} ScanRange;
+
+typedef struct {
+    DbPool *pool;
+    const char *like_pattern;
+    gint64 deadline;
+    ScanRange *ranges;
+    int range_count;
+    gint next_range;
+    gint cancelled;
+    sqlite3_int64 rows_scanned;
+    GMutex mutex;
+    GCond cond;
+} NameScan;
+
+static json_t* row_to_json(sqlite3_stmt *stmt) {
+    json_t *entry = json_object();
+    json_object_set_new(entry, "cpf", json_string((const char*)sqlite3_column_text(stmt, 0)));
+    json_object_set_new(entry, "nome", json_string((const char*)sqlite3_column_text(stmt, 1)));
+    json_object_set_new(entry, "sexo", json_string((const char*)sqlite3_column_text(stmt, 2)));
+    json_object_set_new(entry, "nasc", json_string((const char*)sqlite3_column_text(stmt, 3)));
+    return entry;
+}
+
+static gboolean name_scan_stopped(NameScan *scan) {
+    return g_atomic_int_get(&scan->cancelled) ||
+        (scan->deadline && g_get_monotonic_time() >= scan->deadline);
+}
+
+// Runs every SCAN_PROGRESS_OPS virtual machine instructions; a non-zero return interrupts the statement.
+static int name_scan_progress(void *data) {
+    return name_scan_stopped((NameScan *)data);
+}
+
+// Waits for a pooled connection in short slices so a worker queued behind other scans still notices
+// the deadline or cancellation; returns NULL once the scan has stopped.
+static sqlite3* name_scan_acquire(NameScan *scan) {
+    while (!name_scan_stopped(scan)) {
+        gint64 wait = SCAN_ACQUIRE_POLL_MS * G_TIME_SPAN_MILLISECOND;
+        if (scan->deadline) {
+            wait = MIN(wait, scan->deadline - g_get_monotonic_time());
+        }
+        sqlite3 *db = db_pool_acquire_timeout(scan->pool, wait);
+        if (db) {
+            return db;
+        }
+    }
+    return NULL;
+}
+
+static void name_scan_range(NameScan *scan, sqlite3 *db, ScanRange *range) {
+    const char *sql = "SELECT cpf, nome, sexo, nasc FROM cpf WHERE rowid BETWEEN ? AND ? AND nome LIKE ?";
+    sqlite3_stmt *stmt = NULL;
+    json_t *rows = json_array();
+    int rc = SQLITE_INTERRUPT;
+
+    if (name_scan_stopped(scan)) {
+        // Claimed just as the scan stopped; leave the database alone.
+    } else if ((rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL)) != SQLITE_OK) {
+        fprintf(stderr, "[SCAN] Prepare error: %s\n", sqlite3_errmsg(db));
+    } else {
+        sqlite3_progress_handler(db, SCAN_PROGRESS_OPS, name_scan_progress, scan);
+        sqlite3_bind_int64(stmt, 1, range->first);
+        sqlite3_bind_int64(stmt, 2, range->last);
+        sqlite3_bind_text(stmt, 3, scan->like_pattern, -1, SQLITE_STATIC);
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            json_array_append_new(rows, row_to_json(stmt));
+        }
+        if (rc != SQLITE_DONE && rc != SQLITE_INTERRUPT) {
+            fprintf(stderr, "[SCAN] Step error: %s\n", sqlite3_errmsg(db));
+        }
+        sqlite3_progress_handler(db, 0, NULL, NULL);
+    }
+    sqlite3_finalize(stmt);
+
+    g_mutex_lock(&scan->mutex);
+    range->rows = rows;
+    range->done = TRUE;
+    range->complete = rc == SQLITE_DONE;
+    range->failed = rc != SQLITE_DONE && rc != SQLITE_INTERRUPT;
+    if (range->complete) {
+        scan->rows_scanned += range->last - range->first + 1;
+    }
+    g_cond_broadcast(&scan->cond);
+    g_mutex_unlock(&scan->mutex);
+}
+
+// A connection is held for one range at a time, so concurrent scans take turns on the pool instead of
+// one request's workers keeping their connections until its whole scan is done.
+static gpointer name_scan_worker(gpointer data) {
+    NameScan *scan = (NameScan *)data;
+    sqlite3 *db;
+
+    while ((db = name_scan_acquire(scan)) != NULL) {
+        // Ranges are handed out in rowid order so the coordinator can emit early ones while later ones run.
+        int idx = g_atomic_int_add(&scan->next_range, 1);
+        if (idx < scan->range_count) {
+            name_scan_range(scan, db, &scan->ranges[idx]);
+        }
+        db_pool_release(scan->pool, db);
+        if (idx >= scan->range_count) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// An empty table is reported as COMPLETE with first > last. Running out of time waiting for a
+// connection is reported as TIMED_OUT.
+static NameScanStatus rowid_bounds(DbPool *pool, gint64 deadline, sqlite3_int64 *first, sqlite3_int64 *last) {
+    // Separate subqueries so each aggregate can use the min/max optimization instead of scanning.
+    const char *sql = "SELECT (SELECT min(rowid) FROM cpf), (SELECT max(rowid) FROM cpf)";
+    sqlite3 *db = deadline ? db_pool_acquire_timeout(pool, deadline - g_get_monotonic_time()) : db_pool_acquire(pool);
     sqlite3_stmt *stmt;
-    json_t *result = json_array();
-    char like_pattern[256];
-    snprintf(like_pattern, sizeof(like_pattern), "%%%s%%", name);
+    NameScanStatus status = NAME_SCAN_ERROR;
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
-        sqlite3_bind_text(stmt, 1, like_pattern, -1, SQLITE_STATIC);
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            json_t *entry = json_object();
-            json_object_set_new(entry, "cpf", json_string((const char*)sqlite3_column_text(stmt, 0)));
-            json_object_set_new(entry, "nome", json_string((const char*)sqlite3_column_text(stmt, 1)));
-            json_object_set_new(entry, "sexo", json_string((const char*)sqlite3_column_text(stmt, 2)));
-            json_object_set_new(entry, "nasc", json_string((const char*)sqlite3_column_text(stmt, 3)));
-            json_array_append_new(result, entry);
+    if (!db) {
+        return NAME_SCAN_TIMED_OUT;
+    }
+
+    *first = 1;
+    *last = 0;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        if (sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+            *first = sqlite3_column_int64(stmt, 0);
+            *last = sqlite3_column_int64(stmt, 1);
         }
+        status = NAME_SCAN_COMPLETE;
+    } else {
+        fprintf(stderr, "[SCAN] Bounds error: %s\n", sqlite3_errmsg(db));
     }
     sqlite3_finalize(stmt);
-    return result;
+    db_pool_release(pool, db);
+    return status;
+}
+
+NameScanStatus people_by_name(DbPool *pool, const char *name, int parallelism, gint64 deadline,
+                              NameScanFunc on_rows, gpointer user_data) {
+    printf("[DEBUG] handle_get_person_by_name received name: '%s'\n", name);
+    sqlite3_int64 first, last;
+    NameScanStatus bounds = rowid_bounds(pool, deadline, &first, &last);
+    if (bounds != NAME_SCAN_COMPLETE || first > last) {
+        return bounds;
+    }
+
+    // Names are bounded only by the request head limit, so the pattern is sized to fit.
+    char *like_pattern = g_strdup_printf("%%%s%%", name);
+
+    // Never ask for more workers than there are pooled connections or rows worth splitting.
+    sqlite3_int64 span = last - first + 1;
+    sqlite3_int64 max_workers = (span + SCAN_MIN_RANGE_ROWS - 1) / SCAN_MIN_RANGE_ROWS;
+    int workers = CLAMP(parallelism, 1, db_pool_size(pool));
+    if (workers > max_workers) {
+        workers = (int)max_workers;
+    }
+
+    // Ranges are also the unit of progress, so large tables get more ranges than workers.
+    sqlite3_int64 range_count = MAX(workers * SCAN_RANGES_PER_WORKER,
+                                    (span + SCAN_MAX_RANGE_ROWS - 1) / SCAN_MAX_RANGE_ROWS);
+    NameScan scan = {0};
+    scan.pool = pool;
+    scan.like_pattern = like_pattern;
+    scan.deadline = deadline;
+    scan.range_count = (int)MIN(range_count, span);
+    scan.ranges = g_new0(ScanRange, scan.range_count);
+    g_mutex_init(&scan.mutex);
+    g_cond_init(&scan.cond);
+
+    sqlite3_int64 step = span / scan.range_count;
+    for (int i = 0; i < scan.range_count; i++) {
+        scan.ranges[i].first = first + step * i;
+        scan.ranges[i].last = i == scan.range_count - 1 ? last : first + step * (i + 1) - 1;
+    }
+
+    printf("[SCAN] Scanning rowids %lld..%lld in %d ranges on %d connections\n",
+        (long long)first, (long long)last, scan.range_count, workers);
+
+    GThread **threads = g_new(GThread*, workers);
+    for (int i = 0; i < workers; i++) {
+        threads[i] = g_thread_new("name_scan", name_scan_worker, &scan);
+    }
+
+    // Emit ranges strictly in rowid order so the merged output is deterministic. Between ranges,
+    // report progress every SCAN_PROGRESS_INTERVAL_MS; a failed report means the client is gone.
+    NameScanStatus status = NAME_SCAN_COMPLETE;
+    gint64 next_tick = g_get_monotonic_time() + SCAN_PROGRESS_INTERVAL_MS * G_TIME_SPAN_MILLISECOND;
+    int next = 0;
+
+    g_mutex_lock(&scan.mutex);
+    while (next < scan.range_count) {
+        json_t *rows = NULL;
+        if (scan.ranges[next].done && scan.ranges[next].failed) {
+            status = NAME_SCAN_ERROR;
+            break;
+        } else if (scan.ranges[next].done && !scan.ranges[next].complete) {
+            // Cancellation is only set after this loop, so only the deadline cuts a range short here.
+            // Later ranges that did complete are delivered below.
+            status = NAME_SCAN_TIMED_OUT;
+            break;
+        } else if (scan.ranges[next].done) {
+            rows = scan.ranges[next].rows;
+            scan.ranges[next].rows = NULL;
+            next++;
+        } else {
+            gint64 wake = deadline ? MIN(next_tick, deadline) : next_tick;
+            if (g_cond_wait_until(&scan.cond, &scan.mutex, wake) && g_get_monotonic_time() < wake) {
+                continue;
+            }
+        }
+        sqlite3_int64 rows_scanned = scan.rows_scanned;
+        g_mutex_unlock(&scan.mutex);
+
+        // A finished range is delivered even if the deadline passed while waiting for it.
+        gint64 now = g_get_monotonic_time();
+        gboolean keep_going = TRUE;
+        if (rows) {
+            if (json_array_size(rows) > 0) {
+                keep_going = on_rows(rows, rows_scanned, span, user_data);
+            }
+            json_decref(rows);
+        } else if (!deadline || now < deadline) {
+            keep_going = on_rows(NULL, rows_scanned, span, user_data);
+            next_tick = now + SCAN_PROGRESS_INTERVAL_MS * G_TIME_SPAN_MILLISECOND;
+        }
+        if (!keep_going) {
+            status = NAME_SCAN_CANCELLED;
+        } else if (deadline && now >= deadline) {
+            status = NAME_SCAN_TIMED_OUT;
+        }
+
+        g_mutex_lock(&scan.mutex);
+        if (status != NAME_SCAN_COMPLETE) {
+            break;
+        }
+    }
+    g_mutex_unlock(&scan.mutex);
+
+    if (status != NAME_SCAN_COMPLETE) {
+        g_atomic_int_set(&scan.cancelled, TRUE);
+    }
+    for (int i = 0; i < workers; i++) {
+        g_thread_join(threads[i]);
+    }
+    // Ranges after the first unfinished one may have completed before the deadline; deliver those
+    // too, still in rowid order. The workers have exited, so the ranges can be read without the lock.
+    for (int i = next; status == NAME_SCAN_TIMED_OUT && i < scan.range_count; i++) {
+        ScanRange *range = &scan.ranges[i];
+        if (range->complete && json_array_size(range->rows) > 0 &&
+            !on_rows(range->rows, scan.rows_scanned, span, user_data)) {
+            status = NAME_SCAN_CANCELLED;
+        }
+    }
+    for (int i = 0; i < scan.range_count; i++) {
+        if (scan.ranges[i].rows) {
+            json_decref(scan.ranges[i].rows);
+        }
+    }
+
+    g_free(threads);
+    g_free(scan.ranges);
+    g_free(like_pattern);
+    g_mutex_clear(&scan.mutex);
+    g_cond_clear(&scan.cond);
+    return status;
 }
 
 json_t* people_by_exact_name(sqlite3 *db, const char *name) {
@@ -0,0 +1,74 @@
+#include "response.h"
+#include "server.h"
+#include <stdio.h>
+#include <string.h>
+
+int response_begin(Response *res, int status) {
+    return res->ops->begin(res, status);
+}
+
+int response_send_chunk(Response *res, const char *data) {
+    return res->ops->send_chunk(res, data);
+}
+
+int response_end(Response *res) {
+    return res->ops->end(res);
+}
+
+int response_empty(Response *res, int status) {
+    return res->ops->empty(res, status);
+}
+
+const char* response_reason(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Content Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 501: return "Not Implemented";
+        default: return "Internal Server Error";
+    }
+}
+
+static int http1_begin(Response *res, int status) {
+    SSL *ssl = ((Http1Response *)res)->ssl;
+    char headers[256];
+    int len = snprintf(headers, sizeof(headers),
+        "HTTP/1.1 %d %s\r\n"
+        "Content-Type: application/json\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "Connection: close\r\n\r\n",
+        status, response_reason(status));
+    return SSL_write(ssl, headers, len) > 0 ? 0 : -1;
+}
+
+static int http1_send_chunk(Response *res, const char *data) {
+    return send_chunk(((Http1Response *)res)->ssl, data);
+}
+
+static int http1_end(Response *res) {
+    return SSL_write(((Http1Response *)res)->ssl, "0\r\n\r\n", 5) > 0 ? 0 : -1;
+}
+
+static int http1_empty(Response *res, int status) {
+    SSL *ssl = ((Http1Response *)res)->ssl;
+    char headers[256];
+    int len = snprintf(headers, sizeof(headers),
+        "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+        status, response_reason(status));
+    return SSL_write(ssl, headers, len) > 0 ? 0 : -1;
+}
+
+static const ResponseOps http1_ops = {
+    http1_begin,
+    http1_send_chunk,
+    http1_end,
+    http1_empty
+};
+
+void http1_response_init(Http1Response *res, SSL *ssl) {
+    res->base.ops = &http1_ops;
+    res->ssl = ssl;
+}
@@ -2,15 +2,24 @@
 #include "queries.h"
 #include "globals.h"
 #include "handlers.h"
+#include "db_pool.h"
+#include "http_parser.h"
+#include "http2.h"
+#include "response.h"
 #include <glib.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <sqlite3.h>
 #include <jansson.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/select.h>
 
@@ -18,6 +27,7 @@ typedef struct {
     int client_sock;
     char* cpf_path;
     char* cnpj_path;
+    DbPool *cpf_pool;
 } ThreadData;
 
 GMutex server_mutex;
@@ -26,93 +36,175 @@ GThread *server_thread = NULL;
 
 static int server_sockfd = -1;
 static SSL_CTX *ssl_ctx = NULL;
+static DbPool *cpf_pool = NULL;
+static int scan_threads_per_request = 1;
+static int query_timeout_ms = 0;
+static gint tls_connections = 0;
+static gint ktls_send_connections = 0;
+static gint ktls_recv_connections = 0;
+static HttpLimits http_limits;
 
-void send_chunk(SSL *ssl, const char *data) {
+// Returns -1 once the peer is gone so long-running handlers can stop early.
+int send_chunk(SSL *ssl, const char *data) {
     char chunk_header[32];
     size_t data_len = strlen(data);
-    snprintf(chunk_header, sizeof(chunk_header), "%zx\r\n", data_len);
-    SSL_write(ssl, chunk_header, strlen(chunk_header));
-    SSL_write(ssl, data, data_len);
-    SSL_write(ssl, "\r\n", 2);
-}
+    int header_len = snprintf(chunk_header, sizeof(chunk_header), "%zx\r\n", data_len);
 
-static void handle_client(SSL *ssl, sqlite3 *cpf_db, sqlite3 *cnpj_db) {
-    (void)cnpj_db; // remove this for cnpj queries
-    char buffer[4096];
-    ssize_t bytes = SSL_read(ssl, buffer, sizeof(buffer) - 1);
-    if (bytes <= 0) {
-        printf("[CLIENT] Failed to read request or connection closed\n");
-        return;
+    // Small chunks go out as one TLS record (and one sendmsg when kTLS is active) instead of three.
+    if (data_len <= SEND_CHUNK_COALESCE_BYTES) {
+        char record[sizeof(chunk_header) + SEND_CHUNK_COALESCE_BYTES + 2];
+        memcpy(record, chunk_header, header_len);
+        memcpy(record + header_len, data, data_len);
+        memcpy(record + header_len + data_len, "\r\n", 2);
+        return SSL_write(ssl, record, header_len + data_len + 2) > 0 ? 0 : -1;
     }
 
-    buffer[bytes] = '\0';
-    printf("[CLIENT] Received request: %s\n", buffer);
+    if (SSL_write(ssl, chunk_header, header_len) <= 0 ||
+        SSL_write(ssl, data, data_len) <= 0 ||
+        SSL_write(ssl, "\r\n", 2) <= 0) {
+        return -1;
+    }
+    return 0;
+}
 
-    char method[16], path[256];
-    if (sscanf(buffer, "%15s %255s", method, path) != 2) {
-        const char *bad_req = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
-        SSL_write(ssl, bad_req, strlen(bad_req));
-        return;
+static void send_parse_error(Response *res, HttpParseStatus status) {
+    switch (status) {
+        case HTTP_PARSE_HEAD_TOO_LARGE:
+            response_empty(res, 431);
+            break;
+        case HTTP_PARSE_BODY_TOO_LARGE:
+            response_empty(res, 413);
+            break;
+        case HTTP_PARSE_NOT_IMPLEMENTED:
+            response_empty(res, 501);
+            break;
+        default:
+            response_empty(res, 400);
+            break;
     }
+}
 
+static const char *const name_prefix = "/get-person-by-name/";
+
+gboolean route_is_scan(const char *path) {
+    return strncmp(path, name_prefix, strlen(name_prefix)) == 0;
+}
+
+void route_request(Response *res, DbPool *cpf_pool, const char *method, const char *path, sqlite3 *cpf_db) {
     if (strcmp(method, "GET") != 0) {
-        const char *bad_method = "HTTP/1.1 405 Method Not Allowed\r\nContent-Length: 0\r\n\r\n";
-        SSL_write(ssl, bad_method, strlen(bad_method));
+        response_empty(res, 405);
         return;
     }
 
     const char *cpf_prefix = "/get-person-by-cpf/";
-    const char *name_prefix = "/get-person-by-name/";
     const char *exact_name_prefix = "/get-person-by-exact-name/";
 
     if (strncmp(path, cpf_prefix, strlen(cpf_prefix)) == 0) {
         const char *cpf_number = path + strlen(cpf_prefix);
-        handle_get_person_by_cpf(ssl, cpf_db, cpf_number);
+        handle_get_person_by_cpf(res, cpf_db, cpf_number);
         return;
-    } else if (strncmp(path, name_prefix, strlen(name_prefix)) == 0) {
+    } else if (route_is_scan(path)) {
         const char *name = path + strlen(name_prefix);
-        handle_get_person_by_name(ssl, cpf_db, name);
+        handle_get_person_by_name(res, cpf_pool, scan_threads_per_request, query_timeout_ms, name);
         return;
     } else if (strncmp(path, exact_name_prefix, strlen(exact_name_prefix)) == 0) {
         const char *name = path + strlen(exact_name_prefix);
-        handle_get_person_by_exact_name(ssl, cpf_db, name);
+        handle_get_person_by_exact_name(res, cpf_db, name);
         return;
     }
 
-    const char *not_found = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
-    SSL_write(ssl, not_found, strlen(not_found));
+    response_empty(res, 404);
 }
 
-static gpointer handle_client_thread(gpointer data) {
-    ThreadData *thread_data = (ThreadData *)data;
-    int client_sock = thread_data->client_sock;
-    char *cpf_path = thread_data->cpf_path;
-    char *cnpj_path = thread_data->cnpj_path;
+static void handle_client(SSL *ssl, DbPool *cpf_pool, sqlite3 *cpf_db, sqlite3 *cnpj_db) {
+    (void)cnpj_db; // remove this for cnpj queries
+    HttpRequest req;
+    HttpParseStatus status = HTTP_PARSE_INCOMPLETE;
+    Http1Response res;
+    http_request_init(&req, &http_limits);
+    http1_response_init(&res, ssl);
 
-    SSL *ssl = SSL_new(ssl_ctx);
-    SSL_set_fd(ssl, client_sock);
+    // Requests may span several TLS records, so keep reading into the parser's buffer until it is complete.
+    while (status == HTTP_PARSE_INCOMPLETE) {
+        size_t avail;
+        char *dst = http_request_reserve(&req, &avail);
+        int bytes = SSL_read(ssl, dst, avail > INT_MAX ? INT_MAX : (int)avail);
+        if (bytes <= 0) {
+            printf("[CLIENT] Failed to read request or connection closed\n");
+            http_request_free(&req);
+            return;
+        }
+        status = http_request_commit(&req, bytes);
+    }
 
-    printf("[THREAD] Starting SSL handshake for client fd=%d\n", client_sock);
-    if (SSL_accept(ssl) <= 0) {
-        printf("[THREAD] SSL handshake failed for client fd=%d\n", client_sock);
-        ERR_print_errors_fp(stderr);
-        SSL_free(ssl);
-        close(client_sock);
-        g_free(thread_data->cpf_path);
-        g_free(thread_data->cnpj_path);
-        g_free(thread_data);
-        return NULL;
+    if (status != HTTP_PARSE_DONE) {
+        printf("[CLIENT] Rejected malformed or oversized request\n");
+        send_parse_error(&res.base, status);
+        http_request_free(&req);
+        return;
     }
 
+    printf("[CLIENT] Received request: %s %s\n", req.method.ptr, req.path.ptr);
+    route_request(&res.base, cpf_pool, req.method.ptr, req.path.ptr, cpf_db);
+    http_request_free(&req);
+}
+
+// Prefer h2 when the client offers it; anything else, including no ALPN at all, is served as HTTP/1.1.
+static int select_alpn(SSL *ssl, const unsigned char **out, unsigned char *outlen,
+                       const unsigned char *in, unsigned int inlen, void *arg) {
+    (void)ssl;
+    (void)arg;
+    static const unsigned char protos[] = "\x02h2\x08http/1.1";
+    if (SSL_select_next_proto((unsigned char **)out, outlen, protos, sizeof(protos) - 1, in, inlen) != OPENSSL_NPN_NEGOTIATED) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    return SSL_TLSEXT_ERR_OK;
+}
+
+static gboolean negotiated_h2(SSL *ssl) {
+    const unsigned char *proto;
+    unsigned int proto_len;
+    SSL_get0_alpn_selected(ssl, &proto, &proto_len);
+    return proto_len == 2 && memcmp(proto, "h2", 2) == 0;
+}
+
+// OpenSSL silently falls back to user-space crypto when the kernel refuses TCP_ULP, so check up front
+// whether the tls module can be attached at all. On an unconnected socket a present module answers
+// ENOTCONN, while a missing one answers ENOENT.
+static gboolean ktls_available(void) {
+#if defined(TCP_ULP) && !defined(OPENSSL_NO_KTLS)
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return FALSE;
+    }
+    int rc = setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls"));
+    int err = errno;
+    close(fd);
+    return rc == 0 || err != ENOENT;
+#else
+    return FALSE;
+#endif
+}
+
+static void record_ktls_offload(SSL *ssl, int client_sock) {
+    int ktls_send = BIO_get_ktls_send(SSL_get_wbio(ssl)) > 0;
+    int ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(ssl)) > 0;
+
+    g_atomic_int_inc(&tls_connections);
+    if (ktls_send) g_atomic_int_inc(&ktls_send_connections);
+    if (ktls_recv) g_atomic_int_inc(&ktls_recv_connections);
+    if (ktls_send || ktls_recv) {
+        printf("[THREAD] kTLS offload for client fd=%d: send=%s recv=%s\n",
+            client_sock, ktls_send ? "yes" : "no", ktls_recv ? "yes" : "no");
+    }
+}
+
+static void serve_http1(SSL *ssl, DbPool *cpf_pool, const char *cpf_path, const char *cnpj_path) {
     sqlite3 *cpf_db;
     if (sqlite3_open_v2(cpf_path, &cpf_db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
         fprintf(stderr, "[THREAD] Database error: %s\n", sqlite3_errmsg(cpf_db));
-        SSL_shutdown(ssl);
-        SSL_free(ssl);
-        close(client_sock);
-        g_free(thread_data->cpf_path);
-        g_free(thread_data);
-        return NULL;
+        sqlite3_close(cpf_db);
+        return;
     }
     sqlite3_exec(cpf_db, "PRAGMA synchronous = NORMAL;", NULL, NULL, NULL);
     sqlite3_exec(cpf_db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
@@ -120,32 +212,73 @@ static gpointer handle_client_thread(gpointer data) {
     sqlite3 *cnpj_db;
     if (sqlite3_open_v2(cnpj_path, &cnpj_db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
         fprintf(stderr, "[THREAD] Database error: %s\n", sqlite3_errmsg(cnpj_db));
-        SSL_shutdown(ssl);
+        sqlite3_close(cnpj_db);
+        sqlite3_close(cpf_db);
+        return;
+    }
+    sqlite3_exec(cnpj_db, "PRAGMA synchronous = NORMAL;", NULL, NULL, NULL);
+    sqlite3_exec(cnpj_db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+
+    handle_client(ssl, cpf_pool, cpf_db, cnpj_db);
+
+    sqlite3_close(cpf_db);
+    sqlite3_close(cnpj_db);
+}
+
+static void free_thread_data(ThreadData *thread_data) {
+    db_pool_unref(thread_data->cpf_pool);
+    g_free(thread_data->cpf_path);
+    g_free(thread_data->cnpj_path);
+    g_free(thread_data);
+}
+
+static gpointer handle_client_thread(gpointer data) {
+    ThreadData *thread_data = (ThreadData *)data;
+    int client_sock = thread_data->client_sock;
+    char *cpf_path = thread_data->cpf_path;
+    char *cnpj_path = thread_data->cnpj_path;
+    DbPool *cpf_pool = thread_data->cpf_pool;
+
+    // A client that stops reading fails SSL_write instead of pinning this thread, and its scan, forever.
+    struct timeval send_timeout = { SEND_TIMEOUT_MS / 1000, (SEND_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(client_sock, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+
+    SSL *ssl = SSL_new(ssl_ctx);
+    SSL_set_fd(ssl, client_sock);
+
+    printf("[THREAD] Starting SSL handshake for client fd=%d\n", client_sock);
+    if (SSL_accept(ssl) <= 0) {
+        printf("[THREAD] SSL handshake failed for client fd=%d\n", client_sock);
+        ERR_print_errors_fp(stderr);
         SSL_free(ssl);
         close(client_sock);
-        g_free(thread_data->cnpj_path);
-        g_free(thread_data);
+        free_thread_data(thread_data);
         return NULL;
     }
-    sqlite3_exec(cnpj_db, "PRAGMA synchronous = NORMAL;", NULL, NULL, NULL);
-    sqlite3_exec(cnpj_db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
 
     printf("[THREAD] SSL handshake successful for client fd=%d\n", client_sock);
-    handle_client(ssl, cpf_db, cnpj_db);
+    record_ktls_offload(ssl, client_sock);
+    // h2 streams open their own connections, so the per-connection databases are only for HTTP/1.1.
+    if (negotiated_h2(ssl)) {
+        http2_serve(ssl, client_sock, cpf_path, cpf_pool, &http_limits);
+    } else {
+        serve_http1(ssl, cpf_pool, cpf_path, cnpj_path);
+    }
 
     printf("[THREAD] Closing connection for client fd=%d\n", client_sock);
     SSL_shutdown(ssl);
     SSL_free(ssl);
-    sqlite3_close(cpf_db);
-    sqlite3_close(cnpj_db);
     close(client_sock);
-    g_free(thread_data->cpf_path);
-    g_free(thread_data->cnpj_path);
-    g_free(thread_data);
+    free_thread_data(thread_data);
     return NULL;
 }
 
-int start_server(int port, const char *cpf_path, const char *cnpj_path, const char *interface) {
+int start_server(const ServerParams *params) {
+    int port = params->port;
+    const char *cpf_path = params->cpf_path;
+    const char *cnpj_path = params->cnpj_path;
+    const char *interface = params->interface;
+
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
@@ -155,6 +288,9 @@ int start_server(int port, const char *cpf_path, const char *cnpj_path, const ch
         return -1;
     }
 
+    // A client that disconnects mid-response must surface as a failed SSL_write, not kill the process.
+    signal(SIGPIPE, SIG_IGN);
+
     SSL_library_init();
     OpenSSL_add_all_algorithms();
     SSL_load_error_strings();
@@ -168,15 +304,46 @@ int start_server(int port, const char *cpf_path, const char *cnpj_path, const ch
         return -1;
     }
 
+    int scan_threads = params->scan_threads > 0 ? params->scan_threads : (int)g_get_num_processors();
+    scan_threads_per_request = CLAMP(params->scan_threads_per_request, 1, scan_threads);
+    http_limits = params->http_limits;
+    query_timeout_ms = params->query_timeout_ms;
+    cpf_pool = db_pool_new(cpf_path, scan_threads);
+    if (!cpf_pool) {
+        stop_server();
+        return -1;
+    }
+
+    SSL_CTX_set_alpn_select_cb(ssl_ctx, select_alpn, NULL);
+
+    if (params->ktls) {
+#ifdef SSL_OP_ENABLE_KTLS
+        if (ktls_available()) {
+            SSL_CTX_set_options(ssl_ctx, SSL_OP_ENABLE_KTLS);
+            printf("[SERVER] Kernel TLS offload enabled\n");
+        } else {
+            printf("[SERVER] Kernel tls module unavailable, using user-space TLS\n");
+        }
+#else
+        printf("[SERVER] OpenSSL built without kTLS support, using user-space TLS\n");
+#endif
+    }
+    g_atomic_int_set(&tls_connections, 0);
+    g_atomic_int_set(&ktls_send_connections, 0);
+    g_atomic_int_set(&ktls_recv_connections, 0);
+
     if ((server_sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
         bind(server_sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
         listen(server_sockfd, 10) < 0) {
         perror("Server error");
         stop_server();
+        db_pool_unref(cpf_pool);
+        cpf_pool = NULL;
         return -1;
     }
 
-    printf("[SERVER] Started on %s:%i.\n", interface, port);
+    printf("[SERVER] Started on %s:%i with %d scan threads (%d per request).\n",
+        interface, port, scan_threads, scan_threads_per_request);
     while (TRUE) {
         struct timeval tv = {1, 0};
         fd_set fds;
@@ -200,6 +367,7 @@ int start_server(int port, const char *cpf_path, const char *cnpj_path, const ch
             data->client_sock = client_sock;
             data->cpf_path = g_strdup(cpf_path);
             data->cnpj_path = g_strdup(cnpj_path);
+            data->cpf_pool = db_pool_ref(cpf_pool);
 
             GThread *client_thread = g_thread_new(
                 "client_handler",
@@ -210,8 +378,14 @@ int start_server(int port, const char *cpf_path, const char *cnpj_path, const ch
         }
     }
 
+    printf("[SERVER] kTLS offload: %d of %d connections (send), %d (recv)\n",
+        g_atomic_int_get(&ktls_send_connections), g_atomic_int_get(&tls_connections),
+        g_atomic_int_get(&ktls_recv_connections));
     close(server_sockfd);
     server_sockfd = -1;
+    // Connections still being served keep their own reference; the pool closes after the last one.
+    db_pool_unref(cpf_pool);
+    cpf_pool = NULL;
     return 0;
 }
 
@@ -0,0 +1,99 @@
+#include "http_parser.h"
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Measures the request parser on the server's typical request shapes, against the single-read
+// sscanf scan it replaced. Usage: bench [iterations]
+
+#define BENCH_DEFAULT_ITERATIONS 1000000
+
+typedef struct {
+    const char *name;
+    const char *text;
+} BenchRequest;
+
+static const BenchRequest requests[] = {
+    { "cpf", "GET /get-person-by-cpf/12345678900 HTTP/1.1\r\nHost: localhost:8080\r\n"
+             "User-Agent: curl/8.5.0\r\nAccept: */*\r\n\r\n" },
+    { "name", "GET /get-person-by-name/Jo%C3%A3o%20da%20Silva HTTP/1.1\r\nHost: localhost:8080\r\n"
+              "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+              "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+              "Accept-Language: pt-BR,pt;q=0.9,en;q=0.8\r\nAccept-Encoding: gzip, deflate, br\r\n"
+              "Connection: keep-alive\r\n\r\n" },
+    { "query", "GET /get-person-by-exact-name/MARIA%20SOUZA?limit=100&offset=0&sort=nome HTTP/1.1\r\n"
+               "Host: localhost:8080\r\n\r\n" },
+};
+
+static volatile size_t sink;
+
+static double elapsed_ns(gint64 start, int iterations) {
+    return (double)(g_get_monotonic_time() - start) * 1000.0 / iterations;
+}
+
+// split == 0 copies the whole request in one read, as a single recv() would.
+static size_t parse(HttpRequest *req, const char *text, size_t len, size_t split) {
+    size_t off = 0;
+    HttpParseStatus status = HTTP_PARSE_INCOMPLETE;
+    http_request_init(req, NULL);
+    while (status == HTTP_PARSE_INCOMPLETE && off < len) {
+        size_t avail;
+        char *dst = http_request_reserve(req, &avail);
+        size_t n = MIN(split ? split : avail, MIN(avail, len - off));
+        memcpy(dst, text + off, n);
+        off += n;
+        status = http_request_commit(req, n);
+    }
+    if (status != HTTP_PARSE_DONE) {
+        fprintf(stderr, "[BENCH] Parse failed with status %d\n", status);
+        exit(1);
+    }
+    size_t result = req->path.len + req->header_count;
+    http_request_free(req);
+    return result;
+}
+
+// The old handle_client copied the read into a stack buffer and scanned two tokens.
+static size_t parse_sscanf(const char *text, size_t len) {
+    char buffer[4096];
+    char method[16], path[256];
+    memcpy(buffer, text, len);
+    buffer[len] = '\0';
+    if (sscanf(buffer, "%15s %255s", method, path) != 2) {
+        fprintf(stderr, "[BENCH] sscanf baseline failed\n");
+        exit(1);
+    }
+    return strlen(path);
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_ITERATIONS;
+    HttpRequest *req = g_malloc(sizeof(HttpRequest));
+    printf("[BENCH] %d iterations per case, ns per request\n", iterations);
+    printf("%-8s %10s %10s %10s %10s\n", "request", "sscanf", "one-read", "split-64", "split-1");
+
+    for (size_t r = 0; r < G_N_ELEMENTS(requests); r++) {
+        const char *text = requests[r].text;
+        size_t len = strlen(text);
+        double ns[4];
+
+        gint64 start = g_get_monotonic_time();
+        for (int i = 0; i < iterations; i++) sink += parse_sscanf(text, len);
+        ns[0] = elapsed_ns(start, iterations);
+
+        static const size_t splits[] = { 0, 64, 1 };
+        for (size_t s = 0; s < G_N_ELEMENTS(splits); s++) {
+            // Byte-at-a-time is the worst case, so it gets a tenth of the iterations.
+            int n = splits[s] == 1 ? MAX(iterations / 10, 1) : iterations;
+            start = g_get_monotonic_time();
+            for (int i = 0; i < n; i++) sink += parse(req, text, len, splits[s]);
+            ns[s + 1] = elapsed_ns(start, n);
+        }
+
+        printf("%-8s %10.1f %10.1f %10.1f %10.1f\n", requests[r].name, ns[0], ns[1], ns[2], ns[3]);
+    }
+
+    g_free(req);
+    return 0;
+}
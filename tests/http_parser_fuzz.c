@@ -0,0 +1,453 @@
+#include "http_parser.h"
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Feeds requests to the incremental parser in random splits and checks that the outcome never
+// depends on how the bytes arrived. Usage: fuzz [iterations] [seed]
+
+#define FUZZ_DEFAULT_ITERATIONS 2000
+#define FUZZ_MAX_INPUT (64 * 1024)
+
+typedef struct {
+    const char *name;
+    const char *text;
+    size_t len;
+    HttpLimits limits;
+    HttpParseStatus expected;
+} FuzzCase;
+
+typedef struct {
+    HttpParseStatus status;
+    size_t consumed;
+    gboolean truncated;
+} FeedResult;
+
+static guint64 rng_state;
+static int failures;
+
+static guint32 rng_next(void) {
+    // xorshift64*, so a failing seed can be replayed.
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (guint32)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static size_t rng_range(size_t lo, size_t hi) {
+    return lo + rng_next() % (hi - lo + 1);
+}
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        failures++; \
+        printf("[FUZZ] FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while (0)
+
+// split == 0 hands the parser everything it asks for; otherwise reads are random sizes up to split.
+static FeedResult feed(HttpRequest *req, const HttpLimits *limits, const char *data, size_t len, size_t split) {
+    FeedResult result = { HTTP_PARSE_INCOMPLETE, 0, FALSE };
+    http_request_init(req, limits);
+
+    while (result.status == HTTP_PARSE_INCOMPLETE) {
+        size_t avail;
+        char *dst = http_request_reserve(req, &avail);
+        if (!dst || avail == 0) {
+            CHECK(FALSE, "reserve returned no space while incomplete (len=%zu)", req->len);
+            break;
+        }
+        if (result.consumed == len) {
+            result.truncated = TRUE;
+            break;
+        }
+        size_t n = split ? rng_range(1, split) : avail;
+        n = MIN(n, MIN(avail, len - result.consumed));
+        memcpy(dst, data + result.consumed, n);
+        result.consumed += n;
+        result.status = http_request_commit(req, n);
+    }
+    return result;
+}
+
+static gboolean slice_ok(const HttpRequest *req, const HttpSlice *slice) {
+    if (!slice->ptr) return TRUE;
+    // strlen must agree with len, since routing compares slices as C strings.
+    return slice->ptr >= req->buf && slice->ptr + slice->len < req->buf + req->cap &&
+           slice->ptr[slice->len] == '\0' && strlen(slice->ptr) == slice->len;
+}
+
+static gboolean slice_eq(const HttpSlice *a, const HttpSlice *b) {
+    if (!a->ptr || !b->ptr) return a->ptr == b->ptr;
+    return a->len == b->len && memcmp(a->ptr, b->ptr, a->len) == 0;
+}
+
+static void check_slices(const char *name, const HttpRequest *req) {
+    CHECK(slice_ok(req, &req->method) && slice_ok(req, &req->path) && slice_ok(req, &req->version),
+          "%s: request line slice outside the buffer or not a C string", name);
+    for (size_t i = 0; i < req->header_count; i++) {
+        CHECK(slice_ok(req, &req->headers[i].name) && slice_ok(req, &req->headers[i].value),
+              "%s: header %zu outside the buffer or not a C string", name, i);
+    }
+    for (size_t i = 0; i < req->param_count; i++) {
+        CHECK(slice_ok(req, &req->params[i].name) && slice_ok(req, &req->params[i].value),
+              "%s: param %zu outside the buffer or not a C string", name, i);
+    }
+    CHECK(!req->body.ptr || (req->body.ptr == req->buf + req->head_len && req->body.len == req->content_length),
+          "%s: body slice does not follow the head", name);
+}
+
+static void check_same_request(const char *name, const HttpRequest *a, const HttpRequest *b) {
+    gboolean same = slice_eq(&a->method, &b->method) && slice_eq(&a->path, &b->path) &&
+                    slice_eq(&a->version, &b->version) && slice_eq(&a->body, &b->body) &&
+                    a->header_count == b->header_count && a->param_count == b->param_count;
+    for (size_t i = 0; same && i < a->header_count; i++) {
+        same = slice_eq(&a->headers[i].name, &b->headers[i].name) && slice_eq(&a->headers[i].value, &b->headers[i].value);
+    }
+    for (size_t i = 0; same && i < a->param_count; i++) {
+        same = slice_eq(&a->params[i].name, &b->params[i].name) && slice_eq(&a->params[i].value, &b->params[i].value);
+    }
+    CHECK(same, "%s: split parse differs from single-read parse", name);
+}
+
+// Parses data once in a single read and once with random splits; both must agree.
+static void run_split(const char *name, const HttpLimits *limits, const char *data, size_t len,
+                      int expected) {
+    HttpRequest *whole = g_malloc(sizeof(HttpRequest));
+    HttpRequest *split = g_malloc(sizeof(HttpRequest));
+    size_t max_split = rng_next() % 4 == 0 ? 1 : rng_range(1, 64);
+
+    FeedResult a = feed(whole, limits, data, len, 0);
+    FeedResult b = feed(split, limits, data, len, max_split);
+
+    CHECK(a.status == b.status && a.truncated == b.truncated,
+          "%s: status %d/%d truncated %d/%d with splits up to %zu",
+          name, a.status, b.status, a.truncated, b.truncated, max_split);
+    if (expected >= 0) {
+        CHECK(!a.truncated && a.status == (HttpParseStatus)expected,
+              "%s: expected status %d, got %d (truncated %d)", name, expected, a.status, a.truncated);
+    }
+    if (a.status == HTTP_PARSE_DONE && b.status == HTTP_PARSE_DONE) {
+        check_slices(name, whole);
+        check_slices(name, split);
+        check_same_request(name, whole, split);
+    }
+
+    http_request_free(whole);
+    http_request_free(split);
+    g_free(whole);
+    g_free(split);
+}
+
+static const char *pick_unreserved = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-._~";
+
+// Random bytes, each either kept literal (when safe) or escaped with mixed-case hex.
+static void fuzz_percent_decode(void) {
+    char plain[256];
+    char encoded[256 * 3 + 1];
+    size_t plain_len = rng_range(0, sizeof(plain) - 1);
+    size_t enc_len = 0;
+
+    for (size_t i = 0; i < plain_len; i++) {
+        unsigned char c = (unsigned char)rng_range(1, 255);
+        if (c == '+' || c == '%' || !strchr(pick_unreserved, c) || rng_next() % 3 == 0) {
+            const char *hex = rng_next() % 2 ? "0123456789ABCDEF" : "0123456789abcdef";
+            encoded[enc_len++] = '%';
+            encoded[enc_len++] = hex[c >> 4];
+            encoded[enc_len++] = hex[c & 0xF];
+        } else {
+            encoded[enc_len++] = (char)c;
+        }
+        plain[i] = (char)c;
+    }
+
+    size_t len = enc_len;
+    CHECK(http_percent_decode(encoded, &len, FALSE), "percent: valid encoding rejected");
+    CHECK(len == plain_len && memcmp(encoded, plain, len) == 0 && encoded[len] == '\0',
+          "percent: round trip of %zu bytes failed", plain_len);
+}
+
+static void check_decode(const char *in, gboolean plus_as_space, gboolean ok, const char *out) {
+    char buf[64];
+    size_t len = strlen(in);
+    memcpy(buf, in, len + 1);
+    gboolean result = http_percent_decode(buf, &len, plus_as_space);
+    CHECK(result == ok, "percent: \"%s\" returned %d", in, result);
+    if (ok && result) {
+        CHECK(len == strlen(out) && strcmp(buf, out) == 0, "percent: \"%s\" decoded to \"%s\"", in, buf);
+    }
+}
+
+static void check_percent_decode_cases(void) {
+    check_decode("", FALSE, TRUE, "");
+    check_decode("plain", FALSE, TRUE, "plain");
+    check_decode("a+b", FALSE, TRUE, "a+b");
+    check_decode("a+b", TRUE, TRUE, "a b");
+    check_decode("Jo%C3%A3o%20Silva", FALSE, TRUE, "Jo\xC3\xA3o Silva");
+    check_decode("%2b%2B+", TRUE, TRUE, "++ ");
+    check_decode("%", FALSE, FALSE, NULL);
+    check_decode("%4", FALSE, FALSE, NULL);
+    check_decode("%zz", FALSE, FALSE, NULL);
+    check_decode("a%00b", FALSE, FALSE, NULL);
+}
+
+// Bytes after the request that arrive with the head must not leak into the body, and once the head
+// is parsed reserve must not offer room past the end of the body.
+static void check_trailing_bytes(void) {
+    const char *data = "POST /a?x=1 HTTP/1.1\r\nContent-Length: 5\r\n\r\nhelloGET /b HTTP/1.1\r\n\r\n";
+    size_t len = strlen(data);
+    size_t off = 0;
+    HttpRequest *req = g_malloc(sizeof(HttpRequest));
+    HttpParseStatus status = HTTP_PARSE_INCOMPLETE;
+
+    http_request_init(req, NULL);
+    while (status == HTTP_PARSE_INCOMPLETE && off < len) {
+        size_t avail;
+        char *dst = http_request_reserve(req, &avail);
+        if (req->head_len) {
+            CHECK(req->len + avail == req->head_len + req->content_length,
+                  "trailing: reserve offered %zu bytes past the body", req->len + avail - req->head_len - req->content_length);
+        }
+        size_t n = rng_range(1, 16);
+        n = MIN(n, MIN(avail, len - off));
+        memcpy(dst, data + off, n);
+        off += n;
+        status = http_request_commit(req, n);
+    }
+    CHECK(status == HTTP_PARSE_DONE, "trailing: status %d", status);
+    CHECK(req->body.len == 5 && memcmp(req->body.ptr, "hello", 5) == 0, "trailing: wrong body");
+    http_request_free(req);
+    g_free(req);
+}
+
+// Back-to-back requests on one stream: each completed request hands its read-ahead bytes to the next,
+// which may already be complete or may outgrow the inline buffer, and no byte is lost or duplicated.
+static void check_pipelined(void) {
+    // The second head outgrows two buffer doublings, so its read-ahead can exceed the inline buffer.
+    GString *padding = g_string_new(NULL);
+    GString *big_padding = g_string_new(NULL);
+    for (int i = 0; i < 20; i++) {
+        g_string_append_printf(padding, "X-Padding-%d: %0240d\r\n", i, i);
+        g_string_append_printf(big_padding, "X-Padding-%d: %0480d\r\n", i, i);
+    }
+    char *requests[] = {
+        g_strdup("POST /a?x=1 HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"),
+        g_strdup_printf("GET /b HTTP/1.1\r\n%s\r\n", big_padding->str),
+        g_strdup_printf("GET /c%%20d HTTP/1.0\r\n%s\r\n", padding->str),
+        g_strdup("POST /e HTTP/1.1\r\nContent-Length: 3\r\n\r\nxyz"),
+    };
+    static const char *paths[] = { "/a", "/b", "/c d", "/e" };
+    GString *stream = g_string_new(NULL);
+    for (size_t r = 0; r < G_N_ELEMENTS(requests); r++) {
+        g_string_append(stream, requests[r]);
+    }
+
+    HttpRequest *req = g_malloc(sizeof(HttpRequest));
+    HttpRequest *next = g_malloc(sizeof(HttpRequest));
+    // A large head limit lets one read pull in more than an inline buffer's worth of the next request.
+    HttpLimits limits = { 64 * 1024, 0, 0 };
+    size_t max_split = rng_next() % 2 ? rng_range(1, 32) : rng_range(1, limits.max_head_bytes);
+    size_t off = 0;
+    HttpParseStatus status = http_request_init_with(req, &limits, NULL, 0);
+
+    for (size_t r = 0; r < G_N_ELEMENTS(requests); r++) {
+        while (status == HTTP_PARSE_INCOMPLETE && off < stream->len) {
+            size_t avail;
+            char *dst = http_request_reserve(req, &avail);
+            size_t n = rng_range(1, max_split);
+            n = MIN(n, MIN(avail, stream->len - off));
+            memcpy(dst, stream->str + off, n);
+            off += n;
+            status = http_request_commit(req, n);
+        }
+        CHECK(status == HTTP_PARSE_DONE && strcmp(req->path.ptr, paths[r]) == 0,
+              "pipelined: request %zu status %d with splits up to %zu", r, status, max_split);
+        if (status != HTTP_PARSE_DONE) {
+            break;
+        }
+        CHECK(http_request_consumed(req) == strlen(requests[r]), "pipelined: request %zu consumed %zu bytes",
+              r, http_request_consumed(req));
+        if (r == 0) {
+            CHECK(req->body.len == 5 && memcmp(req->body.ptr, "hello", 5) == 0, "pipelined: wrong body");
+        }
+        check_slices("pipelined", req);
+
+        size_t used = http_request_consumed(req);
+        status = http_request_init_with(next, &limits, req->buf + used, req->len - used);
+        http_request_free(req);
+        HttpRequest *tmp = req;
+        req = next;
+        next = tmp;
+    }
+    CHECK(failures || (status == HTTP_PARSE_INCOMPLETE && req->len == 0 && off == stream->len),
+          "pipelined: %zu bytes left over after the last request", req->len);
+
+    http_request_free(req);
+    g_free(req);
+    g_free(next);
+    for (size_t r = 0; r < G_N_ELEMENTS(requests); r++) {
+        g_free(requests[r]);
+    }
+    g_string_free(stream, TRUE);
+    g_string_free(padding, TRUE);
+    g_string_free(big_padding, TRUE);
+}
+
+// A body larger than the inline buffer forces growth after the head slices exist, so every slice
+// has to be rebased onto the new allocation.
+static void check_growth(void) {
+    GString *text = g_string_new("POST /get-person-by-name/Jo%C3%A3o?limit=10&q=a+b HTTP/1.1\r\n");
+    for (int i = 0; i < 20; i++) {
+        g_string_append_printf(text, "X-Header-%d: value-%d\r\n", i, i);
+    }
+    size_t body_len = rng_range(HTTP_INLINE_BUFFER, 4 * HTTP_INLINE_BUFFER);
+    g_string_append_printf(text, "Content-Length: %zu\r\n\r\n", body_len);
+    for (size_t i = 0; i < body_len; i++) {
+        g_string_append_c(text, 'a' + i % 26);
+    }
+
+    HttpRequest *req = g_malloc(sizeof(HttpRequest));
+    FeedResult result = feed(req, NULL, text->str, text->len, rng_range(1, 512));
+    CHECK(result.status == HTTP_PARSE_DONE, "growth: status %d", result.status);
+    if (result.status == HTTP_PARSE_DONE) {
+        const HttpSlice *h = http_request_header(req, "x-header-19");
+        const HttpSlice *q = http_request_param(req, "q");
+        CHECK(req->buf != req->inline_buf, "growth: buffer never left the inline storage");
+        CHECK(strcmp(req->path.ptr, "/get-person-by-name/Jo\xC3\xA3o") == 0, "growth: path lost after rebase");
+        CHECK(h && strcmp(h->ptr, "value-19") == 0, "growth: header lost after rebase");
+        CHECK(q && strcmp(q->ptr, "a b") == 0, "growth: param lost after rebase");
+        CHECK(req->body.len == body_len && req->body.ptr[body_len - 1] == (char)('a' + (body_len - 1) % 26),
+              "growth: body truncated");
+        check_slices("growth", req);
+    }
+    http_request_free(req);
+    g_free(req);
+    g_string_free(text, TRUE);
+}
+
+static char* long_head(size_t target_len) {
+    GString *text = g_string_new("GET /long HTTP/1.1\r\n");
+    while (text->len < target_len) {
+        // Long lines keep the header count under the default limit.
+        g_string_append(text, "X-Padding: ");
+        for (int i = 0; i < 25; i++) {
+            g_string_append(text, "0123456789");
+        }
+        g_string_append(text, "\r\n");
+    }
+    g_string_append(text, "\r\n");
+    return g_string_free(text, FALSE);
+}
+
+#define CASE(n, t, e) { n, t, sizeof(t) - 1, { 0, 0, 0 }, e }
+#define CASE_LIMITS(n, t, head, headers, body, e) { n, t, sizeof(t) - 1, { head, headers, body }, e }
+
+static const FuzzCase cases[] = {
+    CASE("get", "GET /get-person-by-cpf/12345678900 HTTP/1.1\r\nHost: localhost\r\n\r\n", HTTP_PARSE_DONE),
+    CASE("bare-lf", "GET /lf HTTP/1.0\nHost: x\n\n", HTTP_PARSE_DONE),
+    CASE("query", "GET /get-person-by-name/Jo%C3%A3o%20Silva?limit=10&x=a+b%21&flag&&=v HTTP/1.1\r\n"
+                  "User-Agent:  curl \r\n\r\n", HTTP_PARSE_DONE),
+    CASE("post", "POST /x HTTP/1.1\r\nContent-Length: 11\r\ncontent-length: 11\r\n\r\nhello world", HTTP_PARSE_DONE),
+    CASE("empty-body", "POST /x HTTP/1.1\r\nContent-Length: 0\r\n\r\n", HTTP_PARSE_DONE),
+    CASE("no-target", "GET  HTTP/1.1\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("relative", "GET x HTTP/1.1\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("tab-value", "GET / HTTP/1.1\r\nX-A: a\tb\r\n\r\n", HTTP_PARSE_DONE),
+    CASE("bad-version", "GET / HTTP/2.0\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("bad-minor", "GET / HTTP/1.2\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("bad-minor-byte", "GET / HTTP/1.x\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("nul-target", "GET /get-person-by-cpf/1\0/x HTTP/1.1\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("ctl-target", "GET /a\x01b HTTP/1.1\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("del-method", "G\x7fT / HTTP/1.1\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("cr-target", "GET /a\rb HTTP/1.1\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("nul-header-name", "GET / HTTP/1.1\r\nHo\0st: x\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("nul-header-value", "GET / HTTP/1.1\r\nHost: x\0y\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("ctl-header-value", "GET / HTTP/1.1\r\nHost: x\x1by\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("bad-escape", "GET /a%0 HTTP/1.1\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("nul-escape", "GET /a%00 HTTP/1.1\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("bad-param", "GET /a?x=%G1 HTTP/1.1\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("folding", "GET / HTTP/1.1\r\nA: b\r\n c\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("space-colon", "GET / HTTP/1.1\r\nHost : x\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("bad-length", "POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n", HTTP_PARSE_BAD_REQUEST),
+    CASE("length-mismatch", "POST / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\nab", HTTP_PARSE_BAD_REQUEST),
+    CASE_LIMITS("body-limit", "POST / HTTP/1.1\r\nContent-Length: 6\r\n\r\n123456", 0, 0, 5, HTTP_PARSE_BODY_TOO_LARGE),
+    CASE("body-default", "POST / HTTP/1.1\r\nContent-Length: 1048577\r\n\r\n", HTTP_PARSE_BODY_TOO_LARGE),
+    CASE_LIMITS("head-limit", "GET /aaaaaaaaaaaaaaaaaaaaaaaa HTTP/1.1\r\n\r\n", 20, 0, 0, HTTP_PARSE_HEAD_TOO_LARGE),
+    CASE_LIMITS("header-count", "GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\n\r\n", 0, 2, 0, HTTP_PARSE_HEAD_TOO_LARGE),
+    CASE("chunked", "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", HTTP_PARSE_NOT_IMPLEMENTED),
+};
+
+// Random byte edits of a seed request; only split independence and memory safety are checked.
+static void fuzz_mutation(const FuzzCase *base) {
+    char data[FUZZ_MAX_INPUT];
+    size_t len = MIN(base->len, sizeof(data));
+    memcpy(data, base->text, len);
+
+    int edits = (int)rng_range(1, 8);
+    for (int i = 0; i < edits && len > 0; i++) {
+        size_t at = rng_range(0, len - 1);
+        static const char interesting[] = "\r\n :%?&=+/\t\0";
+        switch (rng_next() % 4) {
+            case 0:
+                data[at] = (char)rng_next();
+                break;
+            case 1:
+                data[at] = interesting[rng_next() % (sizeof(interesting) - 1)];
+                break;
+            case 2:
+                if (len < sizeof(data)) {
+                    memmove(data + at + 1, data + at, len - at);
+                    data[at] = interesting[rng_next() % (sizeof(interesting) - 1)];
+                    len++;
+                }
+                break;
+            default:
+                memmove(data + at, data + at + 1, len - at - 1);
+                len--;
+                break;
+        }
+    }
+
+    run_split(base->name, &base->limits, data, len, -1);
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : FUZZ_DEFAULT_ITERATIONS;
+    guint64 seed = argc > 2 ? strtoull(argv[2], NULL, 0) : (guint64)g_get_real_time();
+    rng_state = seed ? seed : 1;
+    printf("[FUZZ] %d iterations, seed %llu\n", iterations, (unsigned long long)seed);
+
+    check_percent_decode_cases();
+
+    // Heads that outgrow the inline buffer, under and over the head limit.
+    HttpLimits big_head = { 16 * 1024, 0, 0 };
+    char *fits = long_head(HTTP_INLINE_BUFFER + 1000);
+    char *too_long = long_head(16 * 1024);
+
+    for (int i = 0; i < iterations; i++) {
+        for (size_t c = 0; c < G_N_ELEMENTS(cases); c++) {
+            run_split(cases[c].name, &cases[c].limits, cases[c].text, cases[c].len, cases[c].expected);
+        }
+        run_split("truncated", NULL, cases[0].text, cases[0].len - 2, -1);
+        run_split("long-head", &big_head, fits, strlen(fits), HTTP_PARSE_DONE);
+        run_split("too-long-head", &big_head, too_long, strlen(too_long), HTTP_PARSE_HEAD_TOO_LARGE);
+        fuzz_percent_decode();
+        check_trailing_bytes();
+        check_pipelined();
+        check_growth();
+        fuzz_mutation(&cases[rng_next() % G_N_ELEMENTS(cases)]);
+
+        if (failures) {
+            printf("[FUZZ] Stopping at iteration %d; replay with: fuzz %d %llu\n",
+                   i, iterations, (unsigned long long)seed);
+            break;
+        }
+    }
+
+    g_free(fits);
+    g_free(too_long);
+    printf("[FUZZ] %s (%d failures)\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+}